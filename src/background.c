@@ -18,6 +18,10 @@
 #include "image.h"
 #include "gradient.h"
 #include "hint.h"
+#include "desktop.h"
+#include "event.h"
+#include "settings.h"
+#include "timing.h"
 
 /** Enumeration of background types. */
 typedef unsigned char BackgroundType;
@@ -34,9 +38,16 @@ typedef struct BackgroundNode {
    BackgroundType type;          /**< The type of background. */
    char *value;
    Pixmap pixmap;
+   unsigned long size;           /**< Server memory used by pixmap. */
+   unsigned long lastUsed;       /**< Use counter when last shown. */
+   char loaded;                  /**< Set once loading was attempted. */
+   char pending;                 /**< Set while the image is decoded. */
    struct BackgroundNode *next;  /**< Next background in the list. */
 } BackgroundNode;
 
+/** Milliseconds between prefetching neighboring backgrounds. */
+#define PREFETCH_DELAY 500
+
 /** Linked list of backgrounds. */
 static BackgroundNode *backgrounds;
 
@@ -46,8 +57,28 @@ static BackgroundNode *defaultBackground;
 /** The last background loaded. */
 static BackgroundNode *lastBackground;
 
+/** The background whose pixmap is on the root window.
+ * This differs from lastBackground while its image is decoded. */
+static const BackgroundNode *shownBackground;
+
+/** Image backgrounds are loaded on demand and kept within a budget. */
+static unsigned long backgroundUseCounter;
+static unsigned long backgroundCacheUsed;
+static char prefetchPending;
+static char havePrefetch;
+
+static BackgroundNode *GetBackground(int desktop);
+static char IsImageBackground(const BackgroundNode *bp);
+static void RequireBackground(BackgroundNode *bp);
+static void ReleaseBackground(BackgroundNode *bp);
+static void ReduceBackgroundCache(void);
+static void SignalBackground(const TimeType *now, int x, int y, Window w,
+                             void *data);
 static void LoadGradientBackground(BackgroundNode *bp);
 static void LoadImageBackground(BackgroundNode *bp);
+static void HandleBackgroundImage(ImageNode *image, void *data);
+static void CreateImageBackground(BackgroundNode *bp, IconNode *ip);
+static void ShowBackground(const BackgroundNode *bp);
 
 /** Initialize any data needed for background support. */
 void InitializeBackgrounds(void)
@@ -55,9 +86,16 @@ void InitializeBackgrounds(void)
    backgrounds = NULL;
    defaultBackground = NULL;
    lastBackground = NULL;
+   shownBackground = NULL;
+   backgroundUseCounter = 0;
+   backgroundCacheUsed = 0;
+   prefetchPending = 0;
+   havePrefetch = 0;
 }
 
-/** Startup background support. */
+/** Startup background support.
+ * Image backgrounds are not loaded here; see RequireBackground.
+ */
 void StartupBackgrounds(void)
 {
 
@@ -70,14 +108,20 @@ void StartupBackgrounds(void)
       case BACKGROUND_SOLID:
       case BACKGROUND_GRADIENT:
          LoadGradientBackground(bp);
+         bp->loaded = 1;
          break;
       case BACKGROUND_COMMAND:
          /* Nothing to do. */
+         bp->loaded = 1;
          break;
       case BACKGROUND_STRETCH:
       case BACKGROUND_TILE:
       case BACKGROUND_SCALE:
-         LoadImageBackground(bp);
+         /* Loaded when first needed. */
+         if(!havePrefetch) {
+            RegisterCallback(PREFETCH_DELAY, SignalBackground, NULL);
+            havePrefetch = 1;
+         }
          break;
       default:
          Debug("invalid background type in LoadBackground: %d", bp->type);
@@ -96,12 +140,22 @@ void StartupBackgrounds(void)
 void ShutdownBackgrounds(void)
 {
    BackgroundNode *bp;
+   if(havePrefetch) {
+      UnregisterCallback(SignalBackground, NULL);
+      havePrefetch = 0;
+   }
    for(bp = backgrounds; bp; bp = bp->next) {
       if(bp->pixmap != None) {
          JXFreePixmap(display, bp->pixmap);
          bp->pixmap = None;
       }
+      bp->loaded = 0;
+      bp->pending = 0;
    }
+   backgroundCacheUsed = 0;
+   prefetchPending = 0;
+   lastBackground = NULL;
+   shownBackground = NULL;
 }
 
 /** Release any data needed for background support. */
@@ -173,6 +227,10 @@ void SetBackground(int desktop, const char *type, const char *value)
    bp->type = bgType;
    bp->value = CopyString(value);
    bp->pixmap = None;
+   bp->size = 0;
+   bp->lastUsed = 0;
+   bp->loaded = 0;
+   bp->pending = 0;
 
    /* Insert the node into the list. */
    bp->next = backgrounds;
@@ -184,25 +242,19 @@ void SetBackground(int desktop, const char *type, const char *value)
 void LoadBackground(int desktop)
 {
 
-   XSetWindowAttributes attr;
-   unsigned long attrValues;
    BackgroundNode *bp;
 
    /* Determine the background to load. */
-   for(bp = backgrounds; bp; bp = bp->next) {
-      if(bp->desktop == desktop) {
-         break;
-      }
-   }
-   if(!bp) {
-      bp = defaultBackground;
-   }
+   bp = GetBackground(desktop);
 
    /* If there is no background specified for this desktop, just return. */
    if(!bp || !bp->value) {
       return;
    }
 
+   /* Neighboring desktops are loaded shortly after. */
+   prefetchPending = havePrefetch;
+
    /* If the background isn't changing, don't do anything. */
    if(   lastBackground
       && bp->type == lastBackground->type
@@ -217,12 +269,129 @@ void LoadBackground(int desktop)
       return;
    }
 
-   attrValues = CWBackPixmap;
+   RequireBackground(bp);
+   ReduceBackgroundCache();
+
+   /* The old background stays up while the image is decoded. */
+   if(!bp->pending) {
+      ShowBackground(bp);
+   }
+
+}
+
+/** Set the root window background. */
+void ShowBackground(const BackgroundNode *bp)
+{
+   XSetWindowAttributes attr;
    attr.background_pixmap = bp->pixmap;
-   JXChangeWindowAttributes(display, rootWindow, attrValues, &attr);
+   JXChangeWindowAttributes(display, rootWindow, CWBackPixmap, &attr);
    SetPixmapAtom(rootWindow, ATOM_XROOTPMAP_ID, bp->pixmap);
    JXClearWindow(display, rootWindow);
+   shownBackground = bp;
+}
+
+/** Get the background for a desktop. */
+BackgroundNode *GetBackground(int desktop)
+{
+   BackgroundNode *bp;
+   for(bp = backgrounds; bp; bp = bp->next) {
+      if(bp->desktop == desktop) {
+         return bp;
+      }
+   }
+   return defaultBackground;
+}
+
+/** Determine if a background is loaded from an image. */
+char IsImageBackground(const BackgroundNode *bp)
+{
+   switch(bp->type) {
+   case BACKGROUND_STRETCH:
+   case BACKGROUND_TILE:
+   case BACKGROUND_SCALE:
+      return 1;
+   default:
+      return 0;
+   }
+}
+
+/** Make sure a background is loaded and mark it as recently used. */
+void RequireBackground(BackgroundNode *bp)
+{
+   backgroundUseCounter += 1;
+   bp->lastUsed = backgroundUseCounter;
+   if(!bp->loaded) {
+      LoadImageBackground(bp);
+      bp->loaded = 1;
+      backgroundCacheUsed += bp->size;
+   }
+}
+
+/** Release the pixmap of an image background so it is loaded again
+ * the next time it is needed. */
+void ReleaseBackground(BackgroundNode *bp)
+{
+   if(bp->pixmap != None) {
+      JXFreePixmap(display, bp->pixmap);
+      bp->pixmap = None;
+   }
+   backgroundCacheUsed -= bp->size;
+   bp->size = 0;
+   bp->loaded = 0;
+}
+
+/** Release the least recently used image backgrounds until the cache
+ * fits in the budget. The shown background is never released since
+ * its pixmap is published as _XROOTPMAP_ID, and neither is the one
+ * being loaded to replace it.
+ */
+void ReduceBackgroundCache(void)
+{
+   const unsigned long limit = settings.backgroundCacheSize * 1024UL * 1024UL;
+   while(backgroundCacheUsed > limit) {
+      BackgroundNode *oldest = NULL;
+      BackgroundNode *bp;
+      for(bp = backgrounds; bp; bp = bp->next) {
+         if(bp->loaded && bp->pixmap != None && IsImageBackground(bp)
+            && bp != lastBackground && bp != shownBackground
+            && (!oldest || bp->lastUsed < oldest->lastUsed)) {
+            oldest = bp;
+         }
+      }
+      if(!oldest) {
+         break;
+      }
+      ReleaseBackground(oldest);
+   }
+}
+
+/** Load backgrounds of neighboring desktops, one per call. */
+void SignalBackground(const TimeType *now, int x, int y, Window w,
+                      void *data)
+{
+   const unsigned long limit = settings.backgroundCacheSize * 1024UL * 1024UL;
+   unsigned int neighbors[4];
+   unsigned int i;
+
+   if(!prefetchPending) {
+      return;
+   }
 
+   neighbors[0] = GetRightDesktop(currentDesktop);
+   neighbors[1] = GetLeftDesktop(currentDesktop);
+   neighbors[2] = GetBelowDesktop(currentDesktop);
+   neighbors[3] = GetAboveDesktop(currentDesktop);
+   for(i = 0; i < ARRAY_LENGTH(neighbors); i++) {
+      BackgroundNode *bp = GetBackground(neighbors[i]);
+      if(bp && bp->value && !bp->loaded) {
+         if(backgroundCacheUsed < limit) {
+            RequireBackground(bp);
+            ReduceBackgroundCache();
+         }
+         return;
+      }
+   }
+   prefetchPending = 0;
 }
 
 /** Load a gradient background. */
@@ -273,32 +442,94 @@ void LoadGradientBackground(BackgroundNode *bp)
    } else {
       bp->pixmap = JXCreatePixmap(display, rootWindow, 1, rootHeight,
                                   rootDepth);
-      DrawHorizontalGradient(bp->pixmap, rootGC, color1.pixel,
-                             color2.pixel, 0, 0, 1, rootHeight);
+      DrawHorizontalGradient(bp->pixmap, color1.pixel, color2.pixel,
+                             0, 0, 1, rootHeight);
    }
 
 }
 
-/** Load an image background. */
+/** Load an image background.
+ * Images given by a full path are decoded and scaled on the image
+ * threads and finished by HandleBackgroundImage.
+ */
 void LoadImageBackground(BackgroundNode *bp)
 {
 
+   const char preserveAspect = bp->type == BACKGROUND_SCALE;
    IconNode *ip;
-   int width, height;
+   char queued;
 
-   /* Load the icon. */
    ExpandPath(&bp->value);
-   ip = LoadNamedIcon(bp->value, 0, bp->type == BACKGROUND_SCALE);
+   bp->pixmap = None;
+   if(bp->value[0] == '/') {
+      if(bp->type == BACKGROUND_TILE) {
+         queued = RequestImage(bp->value, HandleBackgroundImage, bp);
+      } else {
+         queued = RequestScaledImage(bp->value, rootWidth, rootHeight,
+                                     preserveAspect,
+                                     HandleBackgroundImage, bp);
+      }
+      if(queued) {
+         bp->pending = 1;
+         return;
+      }
+   }
+
+   /* Load the icon. */
+   ip = LoadNamedIcon(bp->value, 0, 0);
+   if(JUNLIKELY(!ip)) {
+      Warning(_("background image not found: \"%s\""), bp->value);
+      return;
+   }
+   if(bp->type == BACKGROUND_TILE) {
+      CreateImageBackground(bp, ip);
+   } else {
+      IconNode *scaled = CreateIconFromImage(
+         ScaleImage(ip->images, rootWidth, rootHeight, preserveAspect), 0);
+      CreateImageBackground(bp, scaled);
+      DestroyIcon(scaled);
+   }
+   DestroyIcon(ip);
+
+}
+
+/** Finish loading an image background once its image is decoded. */
+void HandleBackgroundImage(ImageNode *image, void *data)
+{
+
+   BackgroundNode *bp = (BackgroundNode*)data;
+   IconNode *ip;
+
+   bp->pending = 0;
+   ip = image ? CreateIconFromImage(image, 0) : NULL;
    if(JUNLIKELY(!ip)) {
-      bp->pixmap = None;
       Warning(_("background image not found: \"%s\""), bp->value);
       return;
    }
+   CreateImageBackground(bp, ip);
+   DestroyIcon(ip);
+   backgroundCacheUsed += bp->size;
+
+   if(bp == lastBackground) {
+      ShowBackground(bp);
+   }
+   ReduceBackgroundCache();
+
+}
+
+/** Render the pixmap of an image background.
+ * The image has already been scaled to its final size.
+ */
+void CreateImageBackground(BackgroundNode *bp, IconNode *ip)
+{
+
+   const ImageNode *image = ip->images;
+   int width, height;
 
    /* Determine the size of the background pixmap. */
    if(bp->type == BACKGROUND_TILE) {
-      width = ip->images->width;
-      height = ip->images->height;
+      width = image->width;
+      height = image->height;
    } else {
       width = rootWidth;
       height = rootHeight;
@@ -306,15 +537,14 @@ void LoadImageBackground(BackgroundNode *bp)
 
    /* Create the pixmap. */
    bp->pixmap = JXCreatePixmap(display, rootWindow, width, height, rootDepth);
+   bp->size = (unsigned long)width * height * (rootDepth > 16 ? 4 : 2);
 
    /* Clear the pixmap in case it is too small. */
    JXSetForeground(display, rootGC, 0);
    JXFillRectangle(display, bp->pixmap, rootGC, 0, 0, width, height);
 
-   /* Draw the icon on the background pixmap. */
-   PutIcon(ip, bp->pixmap, 0, 0, 0, width, height);
-
-   /* We don't need the icon anymore. */
-   DestroyIcon(ip);
+   /* Draw the icon centered on the background pixmap. */
+   PutIcon(ip, bp->pixmap, 0, (width - image->width) / 2,
+           (height - image->height) / 2, image->width, image->height);
 
 }
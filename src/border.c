@@ -19,14 +19,34 @@
 #include "grab.h"
 #include "button.h"
 
+/** Status flags that affect the title bar. */
+#define TITLE_STATUS_MASK (STAT_ACTIVE | STAT_FLASH | STAT_SHADED)
+
 static char *buttonNames[BI_COUNT];
 static IconNode *buttonIcons[BI_COUNT];
+static GC borderGC;
+
+/** Mask with the built-in button glyphs, one titleHeight cell per type. */
+static Pixmap buttonMask;
+
+#ifdef USE_XRENDER
+/** Antialiased ring of radius cornerRadius used for frame corners. */
+static Picture cornerMask;
+#endif
 
-static void DrawBorderHelper(const ClientNode *np);
+static void DrawBorderHelper(ClientNode *np);
+static char IsTitleCacheValid(const ClientNode *np,
+                              unsigned int width, unsigned int height);
+static Pixmap UpdateTitleCache(ClientNode *np,
+                               unsigned int width, unsigned int height);
 static void DrawBorderHandles(const ClientNode *np,
                               Pixmap canvas, GC gc);
 static void DrawBorderButtons(const ClientNode *np,
                               Pixmap canvas, GC gc);
+static void CreateButtonMask(void);
+static void DrawBorderButton(BorderIconType t,
+                             unsigned xoffset, unsigned yoffset,
+                             Pixmap canvas, GC gc);
 static char DrawBorderIcon(BorderIconType t,
                            unsigned xoffset, unsigned yoffset,
                            Pixmap canvas);
@@ -39,6 +59,14 @@ static void DrawMaxAButton(unsigned xoffset, unsigned yoffset,
 static void DrawMinButton(unsigned xoffset, unsigned yoffset,
                           Pixmap canvas, GC gc);
 static unsigned GetButtonCount(const ClientNode *np);
+static void DrawFrameOutline(Drawable d, GC gc, long color,
+                             int width, int height);
+
+#ifdef USE_XRENDER
+static void CreateCornerMask(void);
+static char DrawRenderOutline(Drawable d, long color,
+                              int width, int height, int radius);
+#endif
 
 #ifdef USE_SHAPE
 static void FillRoundedRectangle(Drawable d, GC gc, int x, int y,
@@ -54,8 +82,12 @@ void InitializeBorders(void)
 /** Initialize server resources. */
 void StartupBorders(void)
 {
+   XGCValues gcValues;
    unsigned int i;
 
+   gcValues.graphics_exposures = False;
+   borderGC = JXCreateGC(display, rootWindow, GCGraphicsExposures, &gcValues);
+
    for(i = 0; i < BI_COUNT; i++) {
       if(buttonNames[i]) {
          buttonIcons[i] = LoadNamedIcon(buttonNames[i], 1, 1);
@@ -66,6 +98,50 @@ void StartupBorders(void)
       }
    }
 
+   CreateButtonMask();
+#ifdef USE_XRENDER
+   CreateCornerMask();
+#endif
+
+}
+
+/** Release server resources. */
+void ShutdownBorders(void)
+{
+   if(buttonMask != None) {
+      JXFreePixmap(display, buttonMask);
+   }
+#ifdef USE_XRENDER
+   if(cornerMask != None) {
+      JXRenderFreePicture(display, cornerMask);
+   }
+#endif
+   JXFreeGC(display, borderGC);
+}
+
+/** Render the built-in button glyphs to the button mask. */
+void CreateButtonMask(void)
+{
+   const unsigned size = settings.titleHeight;
+   GC gc;
+
+   buttonMask = None;
+   if(size == 0) {
+      return;
+   }
+
+   buttonMask = JXCreatePixmap(display, rootWindow, size * BI_COUNT, size, 1);
+   gc = JXCreateGC(display, buttonMask, 0, NULL);
+   JXSetForeground(display, gc, 0);
+   JXFillRectangle(display, buttonMask, gc, 0, 0, size * BI_COUNT, size);
+
+   JXSetForeground(display, gc, 1);
+   DrawCloseButton(BI_CLOSE * size, 0, buttonMask, gc);
+   DrawMaxIButton(BI_MAX * size, 0, buttonMask, gc);
+   DrawMaxAButton(BI_MAX_ACTIVE * size, 0, buttonMask, gc);
+   DrawMinButton(BI_MIN * size, 0, buttonMask, gc);
+
+   JXFreeGC(display, gc);
 }
 
 /** Destroy structures. */
@@ -341,8 +417,76 @@ void DrawBorder(ClientNode *np)
 
 }
 
+/** Release the cached title bar of a client. */
+void ReleaseBorderCache(ClientNode *np)
+{
+   TitleCacheType *cp = &np->titleCache;
+   if(cp->canvas != None) {
+      ReleaseTextDrawable(cp->canvas);
+      JXFreePixmap(display, cp->canvas);
+      cp->canvas = None;
+   }
+   if(cp->name) {
+      Release(cp->name);
+      cp->name = NULL;
+   }
+}
+
+/** Determine if the cached title bar of a client is up to date. */
+char IsTitleCacheValid(const ClientNode *np,
+                       unsigned int width, unsigned int height)
+{
+   const TitleCacheType *cp = &np->titleCache;
+   if(cp->canvas == None) {
+      return 0;
+   }
+   if(cp->width != width || cp->height != height) {
+      return 0;
+   }
+   if(cp->status != (np->state.status & TITLE_STATUS_MASK)) {
+      return 0;
+   }
+   if(cp->border != np->state.border || cp->maxFlags != np->state.maxFlags) {
+      return 0;
+   }
+   if(cp->icon != np->icon) {
+      return 0;
+   }
+   if(cp->name && np->name) {
+      return !strcmp(cp->name, np->name);
+   } else {
+      return cp->name == np->name;
+   }
+}
+
+/** Prepare the title bar cache of a client for drawing. */
+Pixmap UpdateTitleCache(ClientNode *np,
+                        unsigned int width, unsigned int height)
+{
+   TitleCacheType *cp = &np->titleCache;
+   if(cp->canvas == None || cp->width != width || cp->height != height) {
+      if(cp->canvas != None) {
+         ReleaseTextDrawable(cp->canvas);
+         JXFreePixmap(display, cp->canvas);
+      }
+      cp->canvas = JXCreatePixmap(display, rootWindow, width, height,
+                                  rootDepth);
+      cp->width = width;
+      cp->height = height;
+   }
+   if(cp->name) {
+      Release(cp->name);
+   }
+   cp->name = CopyString(np->name);
+   cp->icon = np->icon;
+   cp->status = np->state.status & TITLE_STATUS_MASK;
+   cp->border = np->state.border;
+   cp->maxFlags = np->state.maxFlags;
+   return cp->canvas;
+}
+
 /** Helper method for drawing borders. */
-void DrawBorderHelper(const ClientNode *np)
+void DrawBorderHelper(ClientNode *np)
 {
 
    ColorType borderTextColor;
@@ -361,6 +505,7 @@ void DrawBorderHelper(const ClientNode *np)
 
    Assert(np);
 
+   gc = borderGC;
    iconSize = GetBorderIconSize();
    GetBorderSize(&np->state, &north, &south, &east, &west);
    width = np->width + east + west;
@@ -386,53 +531,56 @@ void DrawBorderHelper(const ClientNode *np)
    /* Set parent background to reduce flicker. */
    JXSetWindowBackground(display, np->parent, titleColor2);
 
-   canvas = JXCreatePixmap(display, np->parent, width, north, rootDepth);
-   gc = JXCreateGC(display, canvas, 0, NULL);
+   /* Render the title bar unless the cached copy is still good. */
+   if(!IsTitleCacheValid(np, width, north)) {
 
-   /* Clear the window with the right color. */
-   JXSetForeground(display, gc, titleColor2);
-   JXFillRectangle(display, canvas, gc, 0, 0, width, north);
+      canvas = UpdateTitleCache(np, width, north);
 
-   /* Determine how many pixels may be used for the title. */
-   buttonCount = GetButtonCount(np);
-   titleWidth = width - east - west - 5;
-   titleWidth -= settings.titleHeight * (buttonCount + 1);
-   titleWidth -= settings.windowDecorations == DECO_MOTIF
-               ? (buttonCount + 1) : 0;
+      /* Clear the window with the right color. */
+      JXSetForeground(display, gc, titleColor2);
+      JXFillRectangle(display, canvas, gc, 0, 0, width, north);
 
-   /* Draw the top part (either a title or north border). */
-   if((np->state.border & BORDER_TITLE) &&
-      settings.titleHeight > settings.borderWidth) {
+      /* Determine how many pixels may be used for the title. */
+      buttonCount = GetButtonCount(np);
+      titleWidth = width - east - west - 5;
+      titleWidth -= settings.titleHeight * (buttonCount + 1);
+      titleWidth -= settings.windowDecorations == DECO_MOTIF
+                  ? (buttonCount + 1) : 0;
 
-      const unsigned startx = west + 1;
-      const unsigned starty = settings.windowDecorations == DECO_MOTIF
-                            ? (south - 1) : 0;
+      /* Draw the top part (either a title or north border). */
+      if((np->state.border & BORDER_TITLE) &&
+         settings.titleHeight > settings.borderWidth) {
 
-      /* Draw a title bar. */
-      DrawHorizontalGradient(canvas, gc, titleColor1, titleColor2,
-                             0, 1, width, settings.titleHeight - 2);
+         const unsigned startx = west + 1;
+         const unsigned starty = settings.windowDecorations == DECO_MOTIF
+                               ? (south - 1) : 0;
 
-      /* Draw the icon. */
-      if(np->icon && np->width >= settings.titleHeight) {
-         PutIcon(np->icon, canvas, colors[borderTextColor],
-                 startx, starty + (settings.titleHeight - iconSize) / 2,
-                 iconSize, iconSize);
-      }
+         /* Draw a title bar. */
+         DrawHorizontalGradient(canvas, titleColor1, titleColor2,
+                                0, 1, width, settings.titleHeight - 2);
 
-      if(np->name && np->name[0] && titleWidth > 0) {
-         const int sheight = GetStringHeight(FONT_BORDER);
-         const unsigned titlex = startx + settings.titleHeight
-            + (settings.windowDecorations == DECO_MOTIF ? 4 : 0);
-         const unsigned titley = starty + (settings.titleHeight - sheight) / 2;
-         RenderString(canvas, FONT_BORDER, borderTextColor,
-                      titlex, titley, titleWidth, np->name);
-      }
+         /* Draw the icon. */
+         if(np->icon && np->width >= settings.titleHeight) {
+            PutIcon(np->icon, canvas, colors[borderTextColor],
+                    startx, starty + (settings.titleHeight - iconSize) / 2,
+                    iconSize, iconSize);
+         }
 
-      DrawBorderButtons(np, canvas, gc);
+         if(np->name && np->name[0] && titleWidth > 0) {
+            const int sheight = GetStringHeight(FONT_BORDER);
+            const unsigned titlex = startx + settings.titleHeight
+               + (settings.windowDecorations == DECO_MOTIF ? 4 : 0);
+            const unsigned titley = starty + (settings.titleHeight - sheight) / 2;
+            RenderString(canvas, FONT_BORDER, borderTextColor,
+                         titlex, titley, titleWidth, np->name);
+         }
 
-   }
+         DrawBorderButtons(np, canvas, gc);
+
+      }
 
-   /* Copy the pixmap (for the title bar) to the window. */
+   }
+   canvas = np->titleCache.canvas;
 
    /* Copy the pixmap for the title bar and clear the part of
     * the window to be drawn directly. */
@@ -454,8 +602,7 @@ void DrawBorderHelper(const ClientNode *np)
    } else {
       JXSetForeground(display, gc, outlineColor);
       if(np->state.status & STAT_SHADED) {
-         DrawRoundedRectangle(np->parent, gc, 0, 0, width - 1, north - 1,
-                              settings.cornerRadius);
+         DrawFrameOutline(np->parent, gc, outlineColor, width, north);
       } else if(np->state.maxFlags & MAX_HORIZ) {
          if(!(np->state.maxFlags & (MAX_TOP | MAX_VERT))) {
             /* Top */
@@ -477,16 +624,159 @@ void DrawBorderHelper(const ClientNode *np)
                width - 1, height);
          }
       } else {
-         DrawRoundedRectangle(np->parent, gc, 0, 0, width - 1, height - 1,
-                              settings.cornerRadius);
+         DrawFrameOutline(np->parent, gc, outlineColor, width, height);
+      }
+   }
+
+}
+
+/** Draw the rounded outline of a frame.
+ * The GC foreground must already be set to color.
+ */
+void DrawFrameOutline(Drawable d, GC gc, long color, int width, int height)
+{
+#ifdef USE_XRENDER
+   if(DrawRenderOutline(d, color, width - 1, height - 1,
+                        settings.cornerRadius)) {
+      return;
+   }
+#endif
+   DrawRoundedRectangle(d, gc, 0, 0, width - 1, height - 1,
+                        settings.cornerRadius);
+}
+
+#ifdef USE_XRENDER
+
+/** Render the antialiased corner ring used for frame outlines.
+ * The mask is a full ring of diameter 2r+1 centered on pixel (r, r);
+ * each corner of a frame uses one quadrant of it.
+ */
+void CreateCornerMask(void)
+{
+   const int samples = 4;
+   const int radius = settings.cornerRadius;
+   const int size = radius * 2 + 1;
+   const double inner = (radius - 0.5) * (radius - 0.5);
+   const double outer = (radius + 0.5) * (radius + 0.5);
+   XRenderPictFormat *fp;
+   XImage *image;
+   Pixmap pixmap;
+   GC gc;
+   int x, y;
+
+   cornerMask = None;
+   if(!haveRender || radius <= 0) {
+      return;
+   }
+   fp = JXRenderFindStandardFormat(display, PictStandardA8);
+   if(!fp) {
+      return;
+   }
+
+   image = JXCreateImage(display, rootVisual, 8, ZPixmap,
+                         0, NULL, size, size, 8, 0);
+   image->data = Allocate(image->bytes_per_line * size);
+   for(y = 0; y < size; y++) {
+      for(x = 0; x < size; x++) {
+
+         /* Supersample the coverage of the ring for this pixel. */
+         int covered = 0;
+         int sx, sy;
+         for(sy = 0; sy < samples; sy++) {
+            const double dy = y + (sy + 0.5) / samples - (radius + 0.5);
+            for(sx = 0; sx < samples; sx++) {
+               const double dx = x + (sx + 0.5) / samples - (radius + 0.5);
+               const double dist = dx * dx + dy * dy;
+               if(dist >= inner && dist <= outer) {
+                  covered += 1;
+               }
+            }
+         }
+         XPutPixel(image, x, y, (covered * 255) / (samples * samples));
+
       }
    }
 
-   JXFreePixmap(display, canvas);
+   pixmap = JXCreatePixmap(display, rootWindow, size, size, 8);
+   gc = JXCreateGC(display, pixmap, 0, NULL);
+   JXPutImage(display, pixmap, gc, image, 0, 0, 0, 0, size, size);
    JXFreeGC(display, gc);
+   Release(image->data);
+   image->data = NULL;
+   JXDestroyImage(image);
+
+   cornerMask = JXRenderCreatePicture(display, pixmap, fp, 0, NULL);
+   JXFreePixmap(display, pixmap);
+}
+
+/** Draw an antialiased rounded rectangle outline using XRender.
+ * The width and height have the same meaning as for XDrawRectangle.
+ * @return 1 if the outline was drawn, 0 otherwise.
+ */
+char DrawRenderOutline(Drawable d, long color,
+                       int width, int height, int radius)
+{
+   XRenderPictFormat *fp;
+   XRenderColor rcolor;
+   XRectangle rects[4];
+   XColor temp;
+   Picture dest;
+   Picture source;
+
+   if(cornerMask == None || width < radius * 2 || height < radius * 2) {
+      return 0;
+   }
+   fp = JXRenderFindVisualFormat(display, rootVisual);
+   if(!fp) {
+      return 0;
+   }
 
+   temp.pixel = color;
+   GetColorFromPixel(&temp);
+   rcolor.red = temp.red;
+   rcolor.green = temp.green;
+   rcolor.blue = temp.blue;
+   rcolor.alpha = 0xFFFF;
+
+   dest = JXRenderCreatePicture(display, d, fp, 0, NULL);
+   source = JXRenderCreateSolidFill(display, &rcolor);
+
+   /* Straight edges. */
+   rects[0].x = radius;       rects[0].y = 0;
+   rects[0].width = width - radius * 2 + 1;
+   rects[0].height = 1;
+   rects[1].x = radius;       rects[1].y = height;
+   rects[1].width = width - radius * 2 + 1;
+   rects[1].height = 1;
+   rects[2].x = 0;            rects[2].y = radius;
+   rects[2].width = 1;
+   rects[2].height = height - radius * 2 + 1;
+   rects[3].x = width;        rects[3].y = radius;
+   rects[3].width = 1;
+   rects[3].height = height - radius * 2 + 1;
+   JXRenderFillRectangles(display, PictOpSrc, dest, &rcolor, rects, 4);
+
+   /* Corners. */
+   JXRenderComposite(display, PictOpOver, source, cornerMask, dest,
+                     0, 0, 0, 0, 0, 0, radius, radius);
+   JXRenderComposite(display, PictOpOver, source, cornerMask, dest,
+                     0, 0, radius + 1, 0, width - radius + 1, 0,
+                     radius, radius);
+   JXRenderComposite(display, PictOpOver, source, cornerMask, dest,
+                     0, 0, 0, radius + 1, 0, height - radius + 1,
+                     radius, radius);
+   JXRenderComposite(display, PictOpOver, source, cornerMask, dest,
+                     0, 0, radius + 1, radius + 1,
+                     width - radius + 1, height - radius + 1,
+                     radius, radius);
+
+   JXRenderFreePicture(display, source);
+   JXRenderFreePicture(display, dest);
+   return 1;
 }
 
+#endif /* USE_XRENDER */
+
 /** Draw window handles. */
 void DrawBorderHandles(const ClientNode *np, Pixmap canvas, GC gc)
 {
@@ -839,7 +1129,7 @@ void DrawBorderButtons(const ClientNode *np, Pixmap canvas, GC gc)
    if(np->state.border & BORDER_CLOSE) {
 
       JXSetForeground(display, gc, color);
-      DrawCloseButton(xoffset, yoffset, canvas, gc);
+      DrawBorderButton(BI_CLOSE, xoffset, yoffset, canvas, gc);
 
       if(settings.windowDecorations == DECO_MOTIF) {
          JXSetForeground(display, gc, pixelDown);
@@ -863,9 +1153,9 @@ void DrawBorderButtons(const ClientNode *np, Pixmap canvas, GC gc)
 
       JXSetForeground(display, gc, color);
       if(np->state.maxFlags) {
-         DrawMaxAButton(xoffset, yoffset, canvas, gc);
+         DrawBorderButton(BI_MAX_ACTIVE, xoffset, yoffset, canvas, gc);
       } else {
-         DrawMaxIButton(xoffset, yoffset, canvas, gc);
+         DrawBorderButton(BI_MAX, xoffset, yoffset, canvas, gc);
       }
 
       if(settings.windowDecorations == DECO_MOTIF) {
@@ -889,7 +1179,7 @@ void DrawBorderButtons(const ClientNode *np, Pixmap canvas, GC gc)
    if(np->state.border & BORDER_MIN) {
 
       JXSetForeground(display, gc, color);
-      DrawMinButton(xoffset, yoffset, canvas, gc);
+      DrawBorderButton(BI_MIN, xoffset, yoffset, canvas, gc);
 
       if(settings.windowDecorations == DECO_MOTIF) {
          JXSetForeground(display, gc, pixelDown);
@@ -904,6 +1194,21 @@ void DrawBorderButtons(const ClientNode *np, Pixmap canvas, GC gc)
    }
 }
 
+/** Draw a title bar button using its icon or the button mask. */
+void DrawBorderButton(BorderIconType t,
+                      unsigned xoffset, unsigned yoffset,
+                      Pixmap canvas, GC gc)
+{
+   if(DrawBorderIcon(t, xoffset, yoffset, canvas)) {
+      return;
+   }
+   JXSetClipMask(display, gc, buttonMask);
+   JXSetClipOrigin(display, gc, xoffset - t * settings.titleHeight, yoffset);
+   JXFillRectangle(display, canvas, gc, xoffset, yoffset,
+                   settings.titleHeight, settings.titleHeight);
+   JXSetClipMask(display, gc, None);
+}
+
 /** Attempt to draw a border icon. */
 char DrawBorderIcon(BorderIconType t,
                     unsigned xoffset, unsigned yoffset,
@@ -934,10 +1239,6 @@ void DrawCloseButton(unsigned xoffset, unsigned yoffset,
    unsigned x1, y1;
    unsigned x2, y2;
 
-   if(DrawBorderIcon(BI_CLOSE, xoffset, yoffset, canvas)) {
-      return;
-   }
-
    size = (settings.titleHeight + 2) / 3;
    x1 = xoffset + settings.titleHeight / 2 - size / 2;
    y1 = yoffset + settings.titleHeight / 2 - size / 2;
@@ -972,10 +1273,6 @@ void DrawMaxIButton(unsigned xoffset, unsigned yoffset,
    unsigned int x1, y1;
    unsigned int x2, y2;
 
-   if(DrawBorderIcon(BI_MAX, xoffset, yoffset, canvas)) {
-      return;
-   }
-
    size = 2 + (settings.titleHeight + 2) / 3;
    x1 = xoffset + settings.titleHeight / 2 - size / 2;
    y1 = yoffset + settings.titleHeight / 2 - size / 2;
@@ -1025,10 +1322,6 @@ void DrawMaxAButton(unsigned xoffset, unsigned yoffset,
    unsigned x2, y2;
    unsigned x3, y3;
 
-   if(DrawBorderIcon(BI_MAX_ACTIVE, xoffset, yoffset, canvas)) {
-      return;
-   }
-
    size = 2 + (settings.titleHeight + 2) / 3;
    x1 = xoffset + settings.titleHeight / 2 - size / 2;
    y1 = yoffset + settings.titleHeight / 2 - size / 2;
@@ -1093,10 +1386,6 @@ void DrawMinButton(unsigned xoffset, unsigned yoffset,
    unsigned int x1, y1;
    unsigned int x2, y2;
 
-   if(DrawBorderIcon(BI_MIN, xoffset, yoffset, canvas)) {
-      return;
-   }
-
    size = (settings.titleHeight + 2) / 3;
    x1 = xoffset + settings.titleHeight / 2 - size / 2;
    y1 = yoffset + settings.titleHeight / 2 - size / 2;
@@ -1325,5 +1614,6 @@ void SetBorderIcon(BorderIconType t, const char *name)
       Release(buttonNames[t]);
    }
    buttonNames[t] = CopyString(name);
+   PreloadIcon(name);
 }
  
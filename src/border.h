@@ -37,10 +37,25 @@ typedef unsigned char BorderActionType;
 #define BA_RESIZE_E  0x40  /**< Resize east. */
 #define BA_RESIZE_W  0x80  /**< Resize west. */
 
+/** Cached title bar of a client frame.
+ * The title bar is rendered to the canvas and only rendered again
+ * when one of the values used to render it changes.
+ */
+typedef struct TitleCacheType {
+   Pixmap canvas;                /**< The title bar (None if not drawn). */
+   char *name;                   /**< Window name drawn on the canvas. */
+   const struct IconNode *icon;  /**< Icon drawn on the canvas. */
+   unsigned int width;           /**< Width of the canvas. */
+   unsigned int height;          /**< Height of the canvas. */
+   unsigned int status;          /**< Status flags used. */
+   unsigned short border;        /**< Border flags used. */
+   unsigned char maxFlags;       /**< Maximization flags used. */
+} TitleCacheType;
+
 /*@{*/
 void InitializeBorders(void);
 void StartupBorders(void);
-#define ShutdownBorders()      (void)(0)
+void ShutdownBorders(void);
 void DestroyBorders(void);
 /*@}*/
 
@@ -62,6 +77,14 @@ void ResetBorder(const struct ClientNode *np);
  */
 void DrawBorder(struct ClientNode *np);
 
+/** Release the cached title bar of a client.
+ * This is called when the frame is destroyed or when something
+ * the title bar depends on changes in a way DrawBorder can't detect
+ * (for example, a new icon).
+ * @param np The client.
+ */
+void ReleaseBorderCache(struct ClientNode *np);
+
 /** Get the size of a border icon.
  * @return The size in pixels (note that icons are square).
  */
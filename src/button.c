@@ -100,7 +100,7 @@ void DrawButton(ButtonNode *bp)
          JXFillRectangle(display, drawable, gc, x, y, width, height);
       } else {
          /* gradient */
-         DrawHorizontalGradient(drawable, gc, bg1, bg2,
+         DrawHorizontalGradient(drawable, bg1, bg2,
                                 x, y, width, height);
       }
 
@@ -1250,6 +1250,7 @@ void RemoveClient(ClientNode *np)
    if(np->parent) {
       JXDestroyWindow(display, np->parent);
    }
+   ReleaseBorderCache(np);
 
    if(np->name) {
       Release(np->name);
@@ -1336,6 +1337,7 @@ void ReparentClient(ClientNode *np)
       XDeleteContext(display, np->parent, frameContext);
       JXDestroyWindow(display, np->parent);
       np->parent = None;
+      ReleaseBorderCache(np);
 
    } else {
 
@@ -145,6 +145,8 @@ typedef struct ClientNode {
 
    struct IconNode *icon;     /**< Icon assigned to this window. */
 
+   TitleCacheType titleCache; /**< Rendered title bar. */
+
    /** Callback to stop move/resize. */
    void (*controller)(int wasDestroyed);
 
@@ -30,7 +30,9 @@ typedef struct ClockType {
    char *format;                 /**< The time format to use. */
    char *zone;                   /**< The time zone to use (NULL = local). */
    struct ActionType *actions;   /**< Actions */
-   TimeType lastTime;            /**< Currently displayed time. */
+   char *lastString;             /**< Currently displayed time. */
+   unsigned long nextTime;       /**< When the time string next changes. */
+   unsigned int unit;            /**< Smallest unit shown (seconds). */
 
    /* The following are used to control popups. */
    int mousex;                /**< Last mouse x-coordinate. */
@@ -96,6 +98,9 @@ void DestroyClock(void)
       if(clocks->zone) {
          Release(clocks->zone);
       }
+      if(clocks->lastString) {
+         Release(clocks->lastString);
+      }
       DestroyActions(clocks->actions);
       UnregisterCallback(SignalClock, clocks);
 
@@ -128,7 +133,9 @@ TrayComponentType *CreateClock(const char *format, const char *zone,
    clk->format = CopyString(format);
    clk->zone = CopyString(zone);
    clk->actions = NULL;
-   memset(&clk->lastTime, 0, sizeof(clk->lastTime));
+   clk->lastString = NULL;
+   clk->nextTime = 0;
+   clk->unit = GetTimeFormatUnit(clk->format);
 
    cp = CreateTrayComponent();
    cp->object = clk;
@@ -184,13 +191,18 @@ void Resize(TrayComponentType *cp)
    Assert(clk);
 
    if(cp->pixmap != None) {
+      ReleaseTextDrawable(cp->pixmap);
       JXFreePixmap(display, cp->pixmap);
    }
 
    cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width, cp->height,
                                rootDepth);
 
-   memset(&clk->lastTime, 0, sizeof(clk->lastTime));
+   if(clk->lastString) {
+      Release(clk->lastString);
+      clk->lastString = NULL;
+   }
+   clk->nextTime = 0;
 
    GetCurrentTime(&now);
    DrawClock(clk, &now);
@@ -202,6 +214,7 @@ void Destroy(TrayComponentType *cp)
 {
    Assert(cp);
    if(cp->pixmap != None) {
+      ReleaseTextDrawable(cp->pixmap);
       JXFreePixmap(display, cp->pixmap);
    }
 }
@@ -257,10 +270,23 @@ void DrawClock(ClockType *clk, const TimeType *now)
    int width;
    int rwidth;
 
-   /* Only draw if the time changed. */
-   if(now->seconds == clk->lastTime.seconds) {
+   /* Only format the time when the displayed unit may have changed.
+    * A time before the current unit means the clock was set back. */
+   if(now->seconds < clk->nextTime
+      && now->seconds + clk->unit >= clk->nextTime) {
       return;
    }
+   clk->nextTime = now->seconds - now->seconds % clk->unit + clk->unit;
+
+   /* Only draw if the string changed. */
+   timeString = GetTimeString(clk->format, clk->zone);
+   if(clk->lastString) {
+      if(!strcmp(clk->lastString, timeString)) {
+         return;
+      }
+      Release(clk->lastString);
+   }
+   clk->lastString = CopyString(timeString);
 
    /* Clear the area. */
    cp = clk->cp;
@@ -269,13 +295,12 @@ void DrawClock(ClockType *clk, const TimeType *now)
       JXFillRectangle(display, cp->pixmap, rootGC, 0, 0,
                       cp->width, cp->height);
    } else {
-      DrawHorizontalGradient(cp->pixmap, rootGC,
+      DrawHorizontalGradient(cp->pixmap,
                              colors[COLOR_TRAY_BG1], colors[COLOR_TRAY_BG2],
                              0, 0, cp->width, cp->height);
    }
 
    /* Determine if the clock is the right size. */
-   timeString = GetTimeString(clk->format, clk->zone);
    width = GetStringWidth(FONT_TRAY, timeString);
    rwidth = width + 4;
    if(rwidth == clk->cp->requestedWidth || clk->userWidth) {
@@ -290,7 +315,10 @@ void DrawClock(ClockType *clk, const TimeType *now)
 
    } else {
 
-      /* Wrong size. Resize. */
+      /* Wrong size. Resize and draw again. */
+      Release(clk->lastString);
+      clk->lastString = NULL;
+      clk->nextTime = 0;
       clk->cp->requestedWidth = rwidth;
       ResizeTray(clk->cp->tray);
 
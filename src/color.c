@@ -261,6 +261,22 @@ void DestroyColors(void)
    }
 }
 
+/** Determine if 0xRRGGBB pixels can be stored directly in an image. */
+char IsRGB32Image(const XImage *image)
+{
+   const unsigned int one = 1;
+   const int hostOrder = *(const char*)&one ? LSBFirst : MSBFirst;
+   if(rootVisual->class != TrueColor) {
+      return 0;
+   }
+   if(rootVisual->red_mask != 0xFF0000
+      || rootVisual->green_mask != 0x00FF00
+      || rootVisual->blue_mask != 0x0000FF) {
+      return 0;
+   }
+   return image->bits_per_pixel == 32 && image->byte_order == hostOrder;
+}
+
 /** Compute the mask for computing colors in a linear RGB colormap. */
 void ComputeShiftMask(unsigned long maskIn, unsigned long *shiftOut,
                       unsigned long *maskOut)
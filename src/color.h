@@ -86,6 +86,14 @@ void GetColor(XColor *c, char alloc);
  */
 void GetColorFromPixel(XColor *c);
 
+/** Determine if 0xRRGGBB pixels can be stored directly in an image.
+ * This is true for the common 24/32-bit TrueColor visuals and allows
+ * image conversion to skip GetColor and XPutPixel.
+ * @param image An image created for the root visual.
+ * @return 1 if the image holds 32-bit 0x00RRGGBB pixels in host order.
+ */
+char IsRGB32Image(const XImage *image);
+
 /** Get an RGB pixel value from RGB components.
  * This is used when loading images from external sources. When doing
  * this we need to know the color components even if we are using a
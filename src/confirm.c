@@ -348,6 +348,7 @@ void DestroyConfirmDialog(void)
    RemoveClient(dialog->node);
 
    /* Free the pixmap. */
+   ReleaseTextDrawable(dialog->pmap);
    JXFreePixmap(display, dialog->pmap);
 
    /* Free the message. */
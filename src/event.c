@@ -17,7 +17,9 @@
 #include "desktop.h"
 #include "dock.h"
 #include "icon.h"
+#include "image.h"
 #include "key.h"
+#include "misc.h"
 #include "move.h"
 #include "place.h"
 #include "resize.h"
@@ -49,6 +51,7 @@ static CallbackNode *callbacks = NULL;
 static char restack_pending = 0;
 static char task_update_pending = 0;
 static char pager_update_pending = 0;
+static char tray_update_pending = 0;
 
 static void Signal(void);
 static void DispatchBorderButtonEvent(const XButtonEvent *event,
@@ -95,6 +98,7 @@ char WaitForEvent(XEvent *event)
    fd_set fds;
    long sleepTime;
    int fd;
+   int imageFd;
    char handled;
 
 #ifdef ConnectionNumber
@@ -102,6 +106,7 @@ char WaitForEvent(XEvent *event)
 #else
    fd = JXConnectionNumber(display);
 #endif
+   imageFd = GetImageEventFd();
 
    /* Compute how long we should sleep. */
    sleepTime = 10 * 1000;  /* 10 seconds. */
@@ -125,14 +130,28 @@ char WaitForEvent(XEvent *event)
          UpdatePager();
          pager_update_pending = 0;
       }
+      if(tray_update_pending) {
+         FlushTrays();
+         tray_update_pending = 0;
+      }
 
       while(JXPending(display) == 0) {
          FD_ZERO(&fds);
          FD_SET(fd, &fds);
+         if(imageFd >= 0) {
+            FD_SET(imageFd, &fds);
+         }
          timeout.tv_sec = sleepTime / 1000;
          timeout.tv_usec = (sleepTime % 1000) * 1000;
-         if(select(fd + 1, &fds, NULL, NULL, &timeout) <= 0) {
+         if(select(Max(fd, imageFd) + 1, &fds, NULL, NULL, &timeout) <= 0) {
             Signal();
+         } else if(imageFd >= 0 && FD_ISSET(imageFd, &fds)) {
+            ProcessImageEvents();
+         }
+         if(tray_update_pending) {
+            /* Timers may have updated tray components (the clock). */
+            FlushTrays();
+            tray_update_pending = 0;
          }
          if(JUNLIKELY(shouldExit)) {
             return 0;
@@ -1769,3 +1788,9 @@ void RequirePagerUpdate()
 {
    pager_update_pending = 1;
 }
+
+/** Copy updated tray components before waiting for an event. */
+void RequireTrayUpdate()
+{
+   tray_update_pending = 1;
+}
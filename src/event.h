@@ -72,5 +72,8 @@ void RequireTaskUpdate();
 /** Update the pager before waiting for an event. */
 void RequirePagerUpdate();
 
+/** Copy updated tray components before waiting for an event. */
+void RequireTrayUpdate();
+
 #endif /* EVENT_H */
 
@@ -28,11 +28,44 @@ static const char *DEFAULT_FONT = "FreeSans-9";
 static const char *DEFAULT_FONT = "fixed";
 #endif
 
+/** Cached layout of a string.
+ * Converting a string to UTF-8, applying the bidi algorithm, and
+ * measuring it are done once for each font/string pair. The most
+ * recently used entries are kept.
+ */
+typedef struct StringCacheNode {
+   char *str;                       /**< The string as passed in. */
+   char *output;                    /**< UTF-8 string to draw. */
+   int length;                      /**< Length of output in bytes. */
+   int width;                       /**< Width of output in pixels. */
+   unsigned int hash;               /**< Hash of font and string. */
+   FontType font;                   /**< The font used. */
+   struct StringCacheNode *next;    /**< Next node in the hash bucket. */
+   struct StringCacheNode *newer;   /**< More recently used node. */
+   struct StringCacheNode *older;   /**< Less recently used node. */
+} StringCacheNode;
+
+/* Must be a power of two. */
+#define STRING_HASH_SIZE 256
+
+/** Maximum number of cached strings. */
+#define STRING_CACHE_SIZE 512
+
 static char *GetUTF8String(const char *str);
 static void ReleaseUTF8String(char *utf8String);
+static const StringCacheNode *GetStringLayout(FontType ft, const char *str);
+static void ReleaseStringLayout(StringCacheNode *np);
+static void ClearStringCache(void);
 
 static char *fontNames[FONT_COUNT];
 
+static StringCacheNode *stringHash[STRING_HASH_SIZE];
+static StringCacheNode *newestString;
+static StringCacheNode *oldestString;
+static unsigned int stringCount;
+static unsigned long stringHits;
+static unsigned long stringMisses;
+
 #ifdef USE_ICONV
 static const char *UTF8_CODESET = "UTF-8";
 static iconv_t fromUTF8 = (iconv_t)-1;
@@ -45,6 +78,26 @@ static XftFont *fonts[FONT_COUNT];
 static XFontStruct *fonts[FONT_COUNT];
 #endif
 
+#ifdef USE_XFT
+
+/** Number of XftDraw objects to keep.
+ * XftDraw objects are kept for the drawables most recently rendered
+ * to, the most recently used first.
+ */
+#define DRAW_POOL_SIZE 16
+
+static Drawable poolDrawables[DRAW_POOL_SIZE];
+static XftDraw *poolDraws[DRAW_POOL_SIZE];
+static unsigned int poolCount;
+
+static XftDraw *GetXftDraw(Drawable d);
+
+#else
+
+static GC fontGC;
+
+#endif
+
 /** Initialize font data. */
 void InitializeFonts(void)
 {
@@ -57,6 +110,14 @@ void InitializeFonts(void)
       fonts[x] = NULL;
       fontNames[x] = NULL;
    }
+   for(x = 0; x < STRING_HASH_SIZE; x++) {
+      stringHash[x] = NULL;
+   }
+   newestString = NULL;
+   oldestString = NULL;
+   stringCount = 0;
+   stringHits = 0;
+   stringMisses = 0;
 
    /* Allocate a conversion descriptor if we're not using UTF-8. */
 #ifdef USE_ICONV
@@ -85,6 +146,8 @@ void StartupFonts(void)
 
 #ifdef USE_XFT
 
+   poolCount = 0;
+
    for(x = 0; x < FONT_COUNT; x++) {
       if(fontNames[x]) {
          fonts[x] = JXftFontOpenName(display, rootScreen, fontNames[x]);
@@ -105,6 +168,9 @@ void StartupFonts(void)
 
 #else /* USE_XFT */
 
+   fontGC = JXCreateGC(display, rootWindow, 0, NULL);
+   JXSetGraphicsExposures(display, fontGC, False);
+
    for(x = 0; x < FONT_COUNT; x++) {
       if(fontNames[x]) {
          fonts[x] = JXLoadQueryFont(display, fontNames[x]);
@@ -128,6 +194,17 @@ void StartupFonts(void)
 void ShutdownFonts(void)
 {
    unsigned int x;
+   Debug("string cache: %lu hits, %lu misses, %u entries",
+         stringHits, stringMisses, stringCount);
+   ClearStringCache();
+#ifdef USE_XFT
+   while(poolCount > 0) {
+      poolCount -= 1;
+      JXftDrawDestroy(poolDraws[poolCount]);
+   }
+#else
+   JXFreeGC(display, fontGC);
+#endif
    for(x = 0; x < FONT_COUNT; x++) {
       if(fonts[x]) {
 #ifdef USE_XFT
@@ -144,6 +221,7 @@ void ShutdownFonts(void)
 void DestroyFonts(void)
 {
    unsigned int x;
+   ClearStringCache();
    for(x = 0; x < FONT_COUNT; x++) {
       if(fontNames[x]) {
          Release(fontNames[x]);
@@ -231,6 +309,14 @@ void ReleaseUTF8String(char *utf8String)
 
 /** Get the width of a string. */
 int GetStringWidth(FontType ft, const char *str)
+{
+   return GetStringLayout(ft, str)->width;
+}
+
+/** Get the cached layout of a string, creating it if necessary.
+ * The node returned is only valid until the next call.
+ */
+const StringCacheNode *GetStringLayout(FontType ft, const char *str)
 {
 #ifdef USE_XFT
    XGlyphInfo extents;
@@ -241,11 +327,44 @@ int GetStringWidth(FontType ft, const char *str)
    FriBidiParType type = FRIBIDI_PAR_ON;
    int unicodeLength;
 #endif
+   StringCacheNode *np;
+   unsigned int hash;
+   unsigned int index;
    int len;
    char *output;
-   int result;
    char *utf8String;
 
+   /* Look for the string in the cache. */
+   hash = GetStringHash(str) * FONT_COUNT + ft;
+   index = hash & (STRING_HASH_SIZE - 1);
+   for(np = stringHash[index]; np; np = np->next) {
+      if(np->hash == hash && np->font == ft && !strcmp(np->str, str)) {
+         stringHits += 1;
+
+         /* Move to the front of the LRU list. */
+         if(np != newestString) {
+            np->newer->older = np->older;
+            if(np->older) {
+               np->older->newer = np->newer;
+            } else {
+               oldestString = np->newer;
+            }
+            np->newer = NULL;
+            np->older = newestString;
+            newestString->newer = np;
+            newestString = np;
+         }
+         return np;
+
+      }
+   }
+   stringMisses += 1;
+
+   /* Make room for the new entry. */
+   if(stringCount >= STRING_CACHE_SIZE) {
+      ReleaseStringLayout(oldestString);
+   }
+
    /* Convert to UTF-8 if necessary. */
    utf8String = GetUTF8String(str);
 
@@ -259,32 +378,86 @@ int GetStringWidth(FontType ft, const char *str)
    unicodeLength = fribidi_charset_to_unicode(FRIBIDI_CHAR_SET_UTF8,
                                               utf8String, len, temp_i);
    fribidi_log2vis(temp_i, unicodeLength, &type, temp_o, NULL, NULL, NULL);
-   output = AllocateStack(4 * len + 1);
+   output = Allocate(4 * len + 1);
    fribidi_unicode_to_charset(FRIBIDI_CHAR_SET_UTF8, temp_o, unicodeLength,
                               (char*)output);
    len = strlen(output);
+   ReleaseStack(temp_i);
+   ReleaseStack(temp_o);
 #else
-   output = utf8String;
+   output = Allocate(len + 1);
+   memcpy(output, utf8String, len + 1);
 #endif
+   ReleaseUTF8String(utf8String);
+
+   np = Allocate(sizeof(StringCacheNode));
+   np->str = CopyString(str);
+   np->output = output;
+   np->length = len;
+   np->hash = hash;
+   np->font = ft;
 
    /* Get the width of the string. */
 #ifdef USE_XFT
    JXftTextExtentsUtf8(display, fonts[ft], (const unsigned char*)output,
                        len, &extents);
-   result = extents.xOff;
+   np->width = extents.xOff;
 #else
-   result = XTextWidth(fonts[ft], output, len);
+   np->width = XTextWidth(fonts[ft], output, len);
 #endif
 
-   /* Clean up. */
-#ifdef USE_FRIBIDI
-   ReleaseStack(temp_i);
-   ReleaseStack(temp_o);
-   ReleaseStack(output);
-#endif
-   ReleaseUTF8String(utf8String);
+   /* Insert the new entry. */
+   np->next = stringHash[index];
+   stringHash[index] = np;
+   np->newer = NULL;
+   np->older = newestString;
+   if(newestString) {
+      newestString->newer = np;
+   } else {
+      oldestString = np;
+   }
+   newestString = np;
+   stringCount += 1;
 
-   return result;
+   return np;
+}
+
+/** Remove a string layout from the cache. */
+void ReleaseStringLayout(StringCacheNode *np)
+{
+   StringCacheNode **pp;
+
+   /* Remove from the hash. */
+   pp = &stringHash[np->hash & (STRING_HASH_SIZE - 1)];
+   while(*pp != np) {
+      pp = &(*pp)->next;
+   }
+   *pp = np->next;
+
+   /* Remove from the LRU list. */
+   if(np->newer) {
+      np->newer->older = np->older;
+   } else {
+      newestString = np->older;
+   }
+   if(np->older) {
+      np->older->newer = np->newer;
+   } else {
+      oldestString = np->newer;
+   }
+
+   Release(np->str);
+   Release(np->output);
+   Release(np);
+   stringCount -= 1;
+}
+
+/** Remove all string layouts from the cache. */
+void ClearStringCache(void)
+{
+   while(oldestString) {
+      ReleaseStringLayout(oldestString);
+   }
 }
 
 /** Get the height of a string. */
@@ -311,106 +484,95 @@ void SetFont(FontType type, const char *value)
 void RenderString(Drawable d, FontType font, ColorType color,
                   int x, int y, int width, const char *str)
 {
+   const StringCacheNode *layout;
    XRectangle rect;
-   Region renderRegion;
-   int len;
-   char *output;
-#ifdef USE_FRIBIDI
-   FriBidiChar *temp_i;
-   FriBidiChar *temp_o;
-   FriBidiParType type = FRIBIDI_PAR_ON;
-   int unicodeLength;
-#endif
 #ifdef USE_XFT
    XftDraw *xd;
-   XGlyphInfo extents;
-#else
-   XGCValues gcValues;
-   unsigned long gcMask;
-   GC gc;
 #endif
-   char *utf8String;
 
    /* Early return for empty strings. */
    if(!str || !str[0]) {
       return;
    }
 
-   /* Convert to UTF-8 if necessary. */
-   utf8String = GetUTF8String(str);
-
-   /* Get the length of the UTF-8 string. */
-   len = strlen(utf8String);
-
-#ifdef USE_XFT
-   xd = XftDrawCreate(display, d, rootVisual, rootColormap);
-#else
-   gcMask = GCGraphicsExposures;
-   gcValues.graphics_exposures = False;
-   gc = JXCreateGC(display, d, gcMask, &gcValues);
-#endif
-
-
-   /* Apply the bidi algorithm if requested. */
-#ifdef USE_FRIBIDI
-   temp_i = AllocateStack((len + 1) * sizeof(FriBidiChar));
-   temp_o = AllocateStack((len + 1) * sizeof(FriBidiChar));
-   unicodeLength = fribidi_charset_to_unicode(FRIBIDI_CHAR_SET_UTF8,
-                                              utf8String, len, temp_i);
-   fribidi_log2vis(temp_i, unicodeLength, &type, temp_o, NULL, NULL, NULL);
-   output = AllocateStack(4 * len + 1);
-   fribidi_unicode_to_charset(FRIBIDI_CHAR_SET_UTF8, temp_o, unicodeLength,
-                              (char*)output);
-   len = strlen(output);
-#else
-   output = utf8String;
-#endif
+   /* Get the UTF-8, bidi-ordered string and its width. */
+   layout = GetStringLayout(font, str);
 
    /* Get the bounds for the string based on the specified width. */
    rect.x = x;
    rect.y = y;
    rect.height = GetStringHeight(font);
-#ifdef USE_XFT
-   JXftTextExtentsUtf8(display, fonts[font], (const unsigned char*)output,
-                       len, &extents);
-   rect.width = extents.xOff;
-#else
-   rect.width = XTextWidth(fonts[font], output, len);
-#endif
-   rect.width = Min(rect.width, width) + 2;
-
-   /* Combine the width bounds with the region to use. */
-   renderRegion = XCreateRegion();
-   XUnionRectWithRegion(&rect, renderRegion, renderRegion);
+   rect.width = Min(layout->width, width) + 2;
 
    /* Display the string. */
 #ifdef USE_XFT
-   JXftDrawSetClip(xd, renderRegion);
+   xd = GetXftDraw(d);
+   JXftDrawSetClipRectangles(xd, 0, 0, &rect, 1);
    JXftDrawStringUtf8(xd, GetXftColor(color), fonts[font],
                       x, y + fonts[font]->ascent,
-                      (const unsigned char*)output, len);
-   JXftDrawChange(xd, rootWindow);
+                      (const unsigned char*)layout->output, layout->length);
 #else
-   JXSetForeground(display, gc, colors[color]);
-   JXSetRegion(display, gc, renderRegion);
-   JXSetFont(display, gc, fonts[font]->fid);
-   JXDrawString(display, d, gc, x, y + fonts[font]->ascent, output, len);
+   JXSetForeground(display, fontGC, colors[color]);
+   JXSetClipRectangles(display, fontGC, 0, 0, &rect, 1, Unsorted);
+   JXSetFont(display, fontGC, fonts[font]->fid);
+   JXDrawString(display, d, fontGC, x, y + fonts[font]->ascent,
+                layout->output, layout->length);
 #endif
 
-   /* Free any memory used for UTF conversion. */
-#ifdef USE_FRIBIDI
-   ReleaseStack(temp_i);
-   ReleaseStack(temp_o);
-   ReleaseStack(output);
-#endif
-   ReleaseUTF8String(utf8String);
+}
+
+#ifdef USE_XFT
 
-   XDestroyRegion(renderRegion);
+/** Get an XftDraw for a drawable, reusing one if possible. */
+XftDraw *GetXftDraw(Drawable d)
+{
+   XftDraw *xd;
+   unsigned int x;
 
+   for(x = 0; x < poolCount; x++) {
+      if(poolDrawables[x] == d) {
+         break;
+      }
+   }
+   if(x < poolCount) {
+      xd = poolDraws[x];
+   } else {
+      if(poolCount == DRAW_POOL_SIZE) {
+         /* Evict the least recently used. */
+         x = poolCount - 1;
+         JXftDrawDestroy(poolDraws[x]);
+      } else {
+         x = poolCount;
+         poolCount += 1;
+      }
+      xd = JXftDrawCreate(display, d, rootVisual, rootColormap);
+   }
+
+   /* Move to the front. */
+   memmove(&poolDrawables[1], &poolDrawables[0], x * sizeof(Drawable));
+   memmove(&poolDraws[1], &poolDraws[0], x * sizeof(XftDraw*));
+   poolDrawables[0] = d;
+   poolDraws[0] = xd;
+   return xd;
+}
+
+#endif /* USE_XFT */
+
+/** Release text rendering resources for a drawable. */
+void ReleaseTextDrawable(Drawable d)
+{
 #ifdef USE_XFT
-   XftDrawDestroy(xd);
-#else
-   JXFreeGC(display, gc);
+   unsigned int x;
+   for(x = 0; x < poolCount; x++) {
+      if(poolDrawables[x] == d) {
+         JXftDrawDestroy(poolDraws[x]);
+         poolCount -= 1;
+         memmove(&poolDrawables[x], &poolDrawables[x + 1],
+                 (poolCount - x) * sizeof(Drawable));
+         memmove(&poolDraws[x], &poolDraws[x + 1],
+                 (poolCount - x) * sizeof(XftDraw*));
+         return;
+      }
+   }
 #endif
-
 }
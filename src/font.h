@@ -44,6 +44,13 @@ void SetFont(FontType type, const char *value);
 void RenderString(Drawable d, FontType font, ColorType color,
                   int x, int y, int width, const char *str);
 
+/** Release text rendering resources for a drawable.
+ * This must be called before freeing a drawable that was passed
+ * to RenderString.
+ * @param d The drawable.
+ */
+void ReleaseTextDrawable(Drawable d);
+
 /** Get the width of a string.
  * @param ft The font used to determine the width.
  * @param str The string whose width to get.
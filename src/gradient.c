@@ -12,21 +12,60 @@
 #include "color.h"
 #include "main.h"
 
+/** Maximum number of gradient tiles to keep. */
+#define GRADIENT_CACHE_SIZE 32
+
+/** A pre-rendered gradient column (1 pixel wide). */
+typedef struct GradientNode {
+   long fromColor;
+   long toColor;
+   unsigned int height;
+   Pixmap tile;
+   struct GradientNode *next;
+} GradientNode;
+
+/** Most recently used gradient first. */
+static GradientNode *gradients;
+static unsigned int gradientCount;
+static GC gradientGC;
+
+static Pixmap GetGradientTile(long fromColor, long toColor,
+                              unsigned int height);
+static Pixmap CreateGradientTile(long fromColor, long toColor,
+                                 unsigned int height);
+
+/** Initialize gradient data. */
+void StartupGradients(void)
+{
+   XGCValues gcValues;
+   gradients = NULL;
+   gradientCount = 0;
+   gcValues.fill_style = FillTiled;
+   gcValues.graphics_exposures = False;
+   gradientGC = JXCreateGC(display, rootWindow,
+                           GCFillStyle | GCGraphicsExposures, &gcValues);
+}
+
+/** Release gradient data. */
+void ShutdownGradients(void)
+{
+   while(gradients) {
+      GradientNode *next = gradients->next;
+      JXFreePixmap(display, gradients->tile);
+      Release(gradients);
+      gradients = next;
+   }
+   gradientCount = 0;
+   JXFreeGC(display, gradientGC);
+}
+
 /** Draw a horizontal gradient. */
-void DrawHorizontalGradient(Drawable d, GC g,
+void DrawHorizontalGradient(Drawable d,
                             long fromColor, long toColor,
                             int x, int y,
                             unsigned int width, unsigned int height)
 {
 
-   const int shift = 15;
-   unsigned int line;
-   XColor temp;
-   int red, green, blue;
-   int ared, agreen, ablue;
-   int bred, bgreen, bblue;
-   int redStep, greenStep, blueStep;
-
    /* Return if there's nothing to do. */
    if(width == 0 || height == 0) {
       return;
@@ -37,6 +76,69 @@ void DrawHorizontalGradient(Drawable d, GC g,
       return;
    }
 
+   JXSetTile(display, gradientGC, GetGradientTile(fromColor, toColor, height));
+   JXSetTSOrigin(display, gradientGC, x, y);
+   JXFillRectangle(display, d, gradientGC, x, y, width, height);
+
+}
+
+/** Get a gradient tile, creating it if necessary. */
+Pixmap GetGradientTile(long fromColor, long toColor, unsigned int height)
+{
+   GradientNode *gp;
+   GradientNode *prev;
+
+   /* Look for an existing tile, moving it to the front if found. */
+   prev = NULL;
+   for(gp = gradients; gp; gp = gp->next) {
+      if(gp->fromColor == fromColor && gp->toColor == toColor
+         && gp->height == height) {
+         if(prev) {
+            prev->next = gp->next;
+            gp->next = gradients;
+            gradients = gp;
+         }
+         return gp->tile;
+      }
+      prev = gp;
+   }
+
+   /* Not found; reuse the least recently used entry if the cache is full. */
+   if(gradientCount >= GRADIENT_CACHE_SIZE) {
+      prev = NULL;
+      for(gp = gradients; gp->next; gp = gp->next) {
+         prev = gp;
+      }
+      prev->next = NULL;
+      JXFreePixmap(display, gp->tile);
+   } else {
+      gp = Allocate(sizeof(GradientNode));
+      gradientCount += 1;
+   }
+
+   gp->fromColor = fromColor;
+   gp->toColor = toColor;
+   gp->height = height;
+   gp->tile = CreateGradientTile(fromColor, toColor, height);
+   gp->next = gradients;
+   gradients = gp;
+   return gp->tile;
+}
+
+/** Render a gradient column to a new 1 pixel wide pixmap. */
+Pixmap CreateGradientTile(long fromColor, long toColor, unsigned int height)
+{
+
+   const int shift = 15;
+   unsigned int line;
+   XColor temp;
+   XImage *image;
+   Pixmap tile;
+   int red, green, blue;
+   int ared, agreen, ablue;
+   int bred, bgreen, bblue;
+   int redStep, greenStep, blueStep;
+
    /* Load the "from" color. */
    temp.pixel = fromColor;
    GetColorFromPixel(&temp);
@@ -56,6 +158,11 @@ void DrawHorizontalGradient(Drawable d, GC g,
    greenStep = (bgreen - agreen) / (int)height;
    blueStep = (bblue - ablue) / (int)height;
 
+   /* Build the column in memory and upload it in one request. */
+   image = JXCreateImage(display, rootVisual, rootDepth,
+                         ZPixmap, 0, NULL, 1, height, 8, 0);
+   image->data = Allocate(image->bytes_per_line * height);
+
    /* Loop over each line. */
    red = ared;
    blue = ablue;
@@ -68,10 +175,7 @@ void DrawHorizontalGradient(Drawable d, GC g,
       temp.blue = (unsigned short)(blue >> shift);
 
       GetColor(&temp, 0);
-
-      /* Draw the line. */
-      JXSetForeground(display, g, temp.pixel);
-      JXDrawLine(display, d, g, x, y + line, x + width, y + line);
+      XPutPixel(image, 0, line, temp.pixel);
 
       red += redStep;
       green += greenStep;
@@ -79,5 +183,12 @@ void DrawHorizontalGradient(Drawable d, GC g,
 
    }
 
-}
+   tile = JXCreatePixmap(display, rootWindow, 1, height, rootDepth);
+   JXPutImage(display, tile, gradientGC, image, 0, 0, 0, 0, 1, height);
+   Release(image->data);
+   image->data = NULL;
+   JXDestroyImage(image);
 
+   return tile;
+
+}
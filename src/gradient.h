@@ -10,10 +10,17 @@
 #ifndef GRADIENT_H
 #define GRADIENT_H
 
+/*@{*/
+#define InitializeGradients() (void)(0)
+void StartupGradients(void);
+void ShutdownGradients(void);
+#define DestroyGradients()    (void)(0)
+/*@}*/
+
 /** Draw a horizontal gradient.
  * Note that no action is taken if fromColor == toColor.
+ * The gradient is drawn from a cached tile keyed by the colors and height.
  * @param d The drawable on which to draw the gradient.
- * @param g The graphics context to use.
  * @param fromColor The starting color pixel value.
  * @param toColor The ending color pixel value.
  * @param x The x-coordinate.
@@ -21,7 +28,7 @@
  * @param width The width of the area to fill.
  * @param height The height of the area to fill.
  */
-void DrawHorizontalGradient(Drawable d, GC g,
+void DrawHorizontalGradient(Drawable d,
                             long fromColor, long toColor,
                             int x, int y,
                             unsigned int width, unsigned int height);
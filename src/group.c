@@ -16,18 +16,6 @@
 #include "misc.h"
 #include "settings.h"
 
-/** What part of the window to match. */
-typedef unsigned int MatchType;
-#define MATCH_NAME   0  /**< Match the window name. */
-#define MATCH_CLASS  1  /**< Match the window class. */
-
-/** List of match patterns for a group. */
-typedef struct PatternListType {
-   char *pattern;
-   MatchType match;
-   struct PatternListType *next;
-} PatternListType;
-
 /** List of options for a group. */
 typedef struct OptionListType {
    OptionType option;
@@ -38,42 +26,63 @@ typedef struct OptionListType {
 
 /** List of groups. */
 typedef struct GroupType {
-   PatternListType *patterns;
    OptionListType *options;
+   unsigned int index;  /**< Pattern identifier for this group. */
+   char hasClass;       /**< Set if the group has class patterns. */
+   char hasName;        /**< Set if the group has name patterns. */
    struct GroupType *next;
 } GroupType;
 
+/** Groups matching a class/instance pair.
+ * Matching only depends on the window class and name, so the result
+ * of testing every group is saved for windows with the same pair.
+ */
+typedef struct GroupCacheType {
+   char *className;
+   char *instanceName;
+   const GroupType **groups;     /**< Matching groups, in order. */
+   unsigned int count;           /**< Number of matching groups. */
+   struct GroupCacheType *next;
+} GroupCacheType;
+
+/* Must be a power of two. */
+#define CACHE_HASH_SIZE 64
+
+/** Maximum number of class/instance pairs to remember. */
+#define CACHE_MAX_ENTRIES 512
+
 static GroupType *groups = NULL;
+static unsigned int groupCount = 0;
+static struct PatternSetType *classPatterns = NULL;
+static struct PatternSetType *namePatterns = NULL;
+static GroupCacheType *groupCache[CACHE_HASH_SIZE];
+static unsigned int groupCacheCount = 0;
 
-static void ReleasePatternList(PatternListType *lp);
 static void ReleaseOptionList(OptionListType *lp);
-static void AddPattern(PatternListType **lp, const char *pattern,
-                       MatchType match);
+static void AddPattern(struct PatternSetType **sp, const GroupType *gp,
+                       const char *pattern);
 static void ApplyGroup(const GroupType *gp, ClientNode *np);
+static const GroupCacheType *GetGroupCache(const char *className,
+                                           const char *instanceName);
+static void ClearGroupCache(void);
+static char CompareNames(const char *a, const char *b);
 
 /** Destroy group data. */
 void DestroyGroups(void)
 {
    GroupType *gp;
+   ClearGroupCache();
    while(groups) {
       gp = groups->next;
-      ReleasePatternList(groups->patterns);
       ReleaseOptionList(groups->options);
       Release(groups);
       groups = gp;
    }
-}
-
-/** Release a group pattern list. */
-void ReleasePatternList(PatternListType *lp)
-{
-   PatternListType *tp;
-   while(lp) {
-      tp = lp->next;
-      Release(lp->pattern);
-      Release(lp);
-      lp = tp;
-   }
+   groupCount = 0;
+   DestroyPatternSet(classPatterns);
+   classPatterns = NULL;
+   DestroyPatternSet(namePatterns);
+   namePatterns = NULL;
 }
 
 /** Release a group option list. */
@@ -94,11 +103,15 @@ void ReleaseOptionList(OptionListType *lp)
 GroupType *CreateGroup(void)
 {
    GroupType *tp;
+   ClearGroupCache();
    tp = Allocate(sizeof(GroupType));
-   tp->patterns = NULL;
    tp->options = NULL;
+   tp->index = groupCount;
+   tp->hasClass = 0;
+   tp->hasName = 0;
    tp->next = groups;
    groups = tp;
+   groupCount += 1;
    return tp;
 }
 
@@ -107,7 +120,8 @@ void AddGroupClass(GroupType *gp, const char *pattern)
 {
    Assert(gp);
    if(JLIKELY(pattern)) {
-      AddPattern(&gp->patterns, pattern, MATCH_CLASS);
+      AddPattern(&classPatterns, gp, pattern);
+      gp->hasClass = 1;
    } else {
       Warning(_("invalid group class"));
    }
@@ -118,23 +132,30 @@ void AddGroupName(GroupType *gp, const char *pattern)
 {
    Assert(gp);
    if(JLIKELY(pattern)) {
-      AddPattern(&gp->patterns, pattern, MATCH_NAME);
+      AddPattern(&namePatterns, gp, pattern);
+      gp->hasName = 1;
    } else {
       Warning(_("invalid group name"));
    }
 }
 
-/** Add a pattern to a pattern list. */
-void AddPattern(PatternListType **lp, const char *pattern, MatchType match)
+/** Add a pattern for a group to a pattern set.
+ * Note that an invalid pattern still counts as a pattern for the group;
+ * it simply never matches.
+ */
+void AddPattern(struct PatternSetType **sp, const GroupType *gp,
+                const char *pattern)
 {
-   PatternListType *tp;
-   Assert(lp);
+   Assert(sp);
+   Assert(gp);
    Assert(pattern);
-   tp = Allocate(sizeof(PatternListType));
-   tp->next = *lp;
-   *lp = tp;
-   tp->pattern = CopyString(pattern);
-   tp->match = match;
+   ClearGroupCache();
+   if(!*sp) {
+      *sp = CreatePatternSet();
+   }
+   if(JUNLIKELY(!AddPatternToSet(*sp, pattern, gp->index))) {
+      Warning(_("invalid group pattern: %s"), pattern);
+   }
 }
 
 /** Add an option to a group. */
@@ -174,42 +195,123 @@ void AddGroupOptionUnsigned(GroupType *gp, OptionType option,
    lp->next = gp->options;
    gp->options = lp;
 }
+
 /** Apply groups to a client. */
 void ApplyGroups(ClientNode *np)
 {
-   PatternListType *lp;
-   GroupType *gp;
-   char hasClass;
-   char hasName;
-   char matchesClass;
-   char matchesName;
+   const GroupCacheType *cp;
+   unsigned int x;
 
    Assert(np);
+   cp = GetGroupCache(np->className, np->instanceName);
+   for(x = 0; x < cp->count; x++) {
+      ApplyGroup(cp->groups[x], np);
+   }
+
+}
+
+/** Get the groups that apply to a window class and name. */
+const GroupCacheType *GetGroupCache(const char *className,
+                                    const char *instanceName)
+{
+   GroupCacheType *cp;
+   const GroupType *gp;
+   char *matchesClass;
+   char *matchesName;
+   unsigned int index;
+   unsigned int count;
+
+   index = (GetStringHash(className) * 31 + GetStringHash(instanceName))
+         & (CACHE_HASH_SIZE - 1);
+   for(cp = groupCache[index]; cp; cp = cp->next) {
+      if(   CompareNames(cp->className, className)
+         && CompareNames(cp->instanceName, instanceName)) {
+         return cp;
+      }
+   }
+
+   /* Not seen before; look up the matching patterns. */
+   if(groupCacheCount >= CACHE_MAX_ENTRIES) {
+      ClearGroupCache();
+   }
+   matchesClass = AllocateStack(groupCount + 1);
+   matchesName = AllocateStack(groupCount + 1);
+   memset(matchesClass, 0, groupCount + 1);
+   memset(matchesName, 0, groupCount + 1);
+   if(classPatterns) {
+      MatchPatternSet(classPatterns, className, matchesClass);
+   }
+   if(namePatterns) {
+      MatchPatternSet(namePatterns, instanceName, matchesName);
+   }
+
+   /* A group applies if it has no patterns of a kind or if one of its
+    * patterns of that kind matched. Groups are kept in the order
+    * they are to be applied. */
+   count = 0;
    for(gp = groups; gp; gp = gp->next) {
-      hasClass = 0;
-      hasName = 0;
-      matchesClass = 0;
-      matchesName = 0;
-      for(lp = gp->patterns; lp; lp = lp->next) {
-         if(lp->match == MATCH_CLASS) {
-            if(Match(lp->pattern, np->className)) {
-               matchesClass = 1;
-            }
-            hasClass = 1;
-         } else if(lp->match == MATCH_NAME) {
-            if(Match(lp->pattern, np->instanceName)) {
-               matchesName = 1;
-            }
-            hasName = 1;
-         } else {
-            Debug("invalid match in ApplyGroups: %d", lp->match);
-         }
+      if(   gp->hasClass == matchesClass[gp->index]
+         && gp->hasName == matchesName[gp->index]) {
+         count += 1;
       }
-      if(hasName == matchesName && hasClass == matchesClass) {
-         ApplyGroup(gp, np);
+   }
+   cp = Allocate(sizeof(GroupCacheType));
+   cp->className = CopyString(className);
+   cp->instanceName = CopyString(instanceName);
+   cp->groups = count > 0 ? Allocate(sizeof(GroupType*) * count) : NULL;
+   cp->count = 0;
+   for(gp = groups; gp; gp = gp->next) {
+      if(   gp->hasClass == matchesClass[gp->index]
+         && gp->hasName == matchesName[gp->index]) {
+         cp->groups[cp->count] = gp;
+         cp->count += 1;
       }
    }
+   ReleaseStack(matchesClass);
+   ReleaseStack(matchesName);
+
+   cp->next = groupCache[index];
+   groupCache[index] = cp;
+   groupCacheCount += 1;
+   return cp;
+
+}
 
+/** Forget all cached group matches. */
+void ClearGroupCache(void)
+{
+   GroupCacheType *cp;
+   unsigned int x;
+   if(groupCacheCount == 0) {
+      return;
+   }
+   for(x = 0; x < CACHE_HASH_SIZE; x++) {
+      while(groupCache[x]) {
+         cp = groupCache[x]->next;
+         if(groupCache[x]->className) {
+            Release(groupCache[x]->className);
+         }
+         if(groupCache[x]->instanceName) {
+            Release(groupCache[x]->instanceName);
+         }
+         if(groupCache[x]->groups) {
+            Release(groupCache[x]->groups);
+         }
+         Release(groupCache[x]);
+         groupCache[x] = cp;
+      }
+   }
+   groupCacheCount = 0;
+}
+
+/** Compare two names, either of which may be NULL. */
+char CompareNames(const char *a, const char *b)
+{
+   if(a && b) {
+      return !strcmp(a, b);
+   } else {
+      return a == b;
+   }
 }
 
 /** Apply a group to a client. */
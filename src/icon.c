@@ -18,6 +18,8 @@
 #include "color.h"
 #include "settings.h"
 #include "border.h"
+#include "tray.h"
+#include "shm.h"
 
 IconNode emptyIcon;
 
@@ -28,9 +30,37 @@ IconNode emptyIcon;
 /* Must be a power of two. */
 #define HASH_SIZE 128
 
+/** Maximum number of images read from _NET_WM_ICON. */
+#define MAX_NET_WM_ICONS 16
+
+/** Minimum icon size kept from _NET_WM_ICON (for menus). */
+#define MIN_NET_WM_ICON_SIZE 32
+
+/** Size of the icon path index hash (must be a power of two). */
+#define INDEX_HASH_SIZE 1024
+
+/** Entry in the icon path index. */
+typedef struct IconIndexNode {
+   char *name;                   /**< Name to look up. */
+   char *fileName;               /**< Full path of the best file. */
+   unsigned int pathIndex;       /**< Position of the icon path. */
+   unsigned int extIndex;        /**< Position of the extension. */
+   struct IconIndexNode *next;
+} IconIndexNode;
+
+/** Location of an image within _NET_WM_ICON. */
+typedef struct NetWMIconImage {
+   long offset;         /**< Offset of the header in CARD32s. */
+   unsigned long width;
+   unsigned long height;
+} NetWMIconImage;
+
 /** Linked list of icon paths. */
 typedef struct IconPathNode {
    char *path;
+#ifdef HAVE_SYS_INOTIFY_H
+   int watch;           /**< inotify watch (-1 if the path is missing). */
+#endif
    struct IconPathNode *next;
 } IconPathNode;
 
@@ -64,13 +94,24 @@ static const unsigned EXTENSION_COUNT = ARRAY_LENGTH(ICON_EXTENSIONS);
 static const unsigned MAX_EXTENSION_LENGTH = 5;
 
 static IconNode **iconHash;
+static IconNode **binaryHash;
 static IconPathNode *iconPaths;
 static IconPathNode *iconPathsTail;
+static IconIndexNode **iconIndex;
+static IconPathNode *preloadNames;
+static char preloadStarted;
+#ifdef HAVE_SYS_INOTIFY_H
+static int iconWatch = -1;
+#endif
 static GC iconGC;
 static char iconSizeSet = 0;
 
-static void DoDestroyIcon(int index, IconNode *icon);
+static void DoDestroyIcon(IconNode **list, IconNode *icon);
 static void ReadNetWMIcon(ClientNode *np);
+static unsigned int ReadNetWMIconHeaders(Window w, NetWMIconImage *images);
+static char ReadNetWMIconRange(Window w, long offset, unsigned long count,
+                               unsigned long *dest);
+static unsigned long GetNetWMIconSize(void);
 static void ReadWMHintIcon(ClientNode *np);
 static IconNode *CreateIcon(void);
 static IconNode *GetDefaultIcon(void);
@@ -82,6 +123,19 @@ static IconNode *CreateIconFromBinary(const unsigned long *data,
                                       unsigned int length);
 static IconNode *LoadNamedIconHelper(const char *name, const char *path,
                                      char save, char preserveAspect);
+static void CreateIconIndex(void);
+static void DestroyIconIndex(void);
+static void AddIconIndexEntry(const char *name, unsigned nameLength,
+                              const char *fileName,
+                              unsigned pathIndex, unsigned extIndex);
+static const IconIndexNode *FindIconIndexEntry(const char *name);
+static void UpdateIconIndex(void);
+#ifdef HAVE_SYS_INOTIFY_H
+static void WatchIconPathParent(const char *path);
+static char IsIconIndexEvent(const struct inotify_event *event);
+#endif
+static void RequestIcon(const char *name);
+static void HandlePreloadedIcon(ImageNode *image, void *data);
 
 static ImageNode *GetBestImage(IconNode *icon, int rwidth, int rheight);
 static ScaledIconNode *GetScaledIcon(IconNode *icon, ImageNode *iconImage,
@@ -90,6 +144,14 @@ static ScaledIconNode *GetScaledIcon(IconNode *icon, ImageNode *iconImage,
 static void InsertIcon(IconNode *icon);
 static IconNode *FindIcon(const char *name);
 static unsigned int GetHash(const char *str);
+static unsigned int GetBinaryHash(const unsigned long *data,
+                                  unsigned int length);
+static IconNode *FindBinaryIcon(unsigned int hash,
+                                const unsigned long *data,
+                                unsigned int length);
+static void InsertBinaryIcon(IconNode *icon, unsigned int hash,
+                             const unsigned long *data,
+                             unsigned int length);
 
 /** Initialize icon data.
  * This must be initialized before parsing the configuration.
@@ -99,9 +161,14 @@ void InitializeIcons(void)
    unsigned int x;
    iconPaths = NULL;
    iconPathsTail = NULL;
+   iconIndex = NULL;
+   preloadNames = NULL;
+   preloadStarted = 0;
    iconHash = Allocate(sizeof(IconNode*) * HASH_SIZE);
+   binaryHash = Allocate(sizeof(IconNode*) * HASH_SIZE);
    for(x = 0; x < HASH_SIZE; x++) {
       iconHash[x] = NULL;
+      binaryHash[x] = NULL;
    }
    memset(&emptyIcon, 0, sizeof(emptyIcon));
    iconSizeSet = 0;
@@ -124,6 +191,18 @@ void StartupIcons(void)
    iconSize.width_inc = 1;
    iconSize.height_inc = 1;
    JXSetIconSizes(display, rootWindow, &iconSize, 1);
+
+   CreateIconIndex();
+
+   /* Start decoding the icons named in the configuration. */
+   preloadStarted = 1;
+   while(preloadNames) {
+      IconPathNode *pn = preloadNames->next;
+      RequestIcon(preloadNames->path);
+      Release(preloadNames->path);
+      Release(preloadNames);
+      preloadNames = pn;
+   }
 }
 
 /** Shutdown icon support. */
@@ -132,9 +211,20 @@ void ShutdownIcons(void)
    unsigned int x;
    for(x = 0; x < HASH_SIZE; x++) {
       while(iconHash[x]) {
-         DoDestroyIcon(x, iconHash[x]);
+         DoDestroyIcon(&iconHash[x], iconHash[x]);
+      }
+      while(binaryHash[x]) {
+         DoDestroyIcon(&binaryHash[x], binaryHash[x]);
       }
    }
+   DestroyIconIndex();
+   preloadStarted = 0;
+#ifdef HAVE_SYS_INOTIFY_H
+   if(iconWatch >= 0) {
+      close(iconWatch);
+      iconWatch = -1;
+   }
+#endif
    JXFreeGC(display, iconGC);
 }
 
@@ -149,10 +239,20 @@ void DestroyIcons(void)
       iconPaths = pn;
    }
    iconPathsTail = NULL;
+   while(preloadNames) {
+      pn = preloadNames->next;
+      Release(preloadNames->path);
+      Release(preloadNames);
+      preloadNames = pn;
+   }
    if(iconHash) {
       Release(iconHash);
       iconHash = NULL;
    }
+   if(binaryHash) {
+      Release(binaryHash);
+      binaryHash = NULL;
+   }
 }
 
 /** Add an icon search path. */
@@ -184,6 +284,9 @@ void AddIconPath(char *path)
       ip->path[length + 1] = 0;
    }
    ExpandPath(&ip->path);
+#ifdef HAVE_SYS_INOTIFY_H
+   ip->watch = -1;
+#endif
    ip->next = NULL;
 
    if(iconPathsTail) {
@@ -219,7 +322,7 @@ void PutIcon(IconNode *icon, Drawable d, long fg,
       /* If we support xrender, use it. */
 #ifdef USE_XRENDER
       if(haveRender) {
-         PutScaledRenderIcon(imageNode, d, ix, iy);
+         PutScaledRenderIcon(node, d, ix, iy);
          return;
       }
 #endif
@@ -252,12 +355,20 @@ void PutIcon(IconNode *icon, Drawable d, long fg,
 /** Load the icon for a client. */
 void LoadIcon(ClientNode *np)
 {
-   /* If client already has an icon, destroy it first. */
-   DestroyIcon(np->icon);
+   IconNode *oldIcon = np->icon;
    np->icon = NULL;
 
-   /* Attempt to read _NET_WM_ICON for an icon. */
+   /* Attempt to read _NET_WM_ICON for an icon.
+    * The old icon is released afterwards so that unchanged data maps
+    * back to the same shared icon without decoding it again.
+    */
    ReadNetWMIcon(np);
+   if(oldIcon) {
+      if(np->icon != oldIcon) {
+         ReleaseBorderCache(np);
+      }
+      DestroyIcon(oldIcon);
+   }
    if(np->icon) {
       return;
    }
@@ -294,6 +405,20 @@ IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect)
    } else if(name[0] == '/') {
       return CreateIconFromFile(name, save, preserveAspect);
    } else {
+
+      /* Use the index unless the name refers to a subdirectory. */
+      UpdateIconIndex();
+      if(iconIndex && !strchr(name, '/')) {
+         const IconIndexNode *entry = FindIconIndexEntry(name);
+         if(!entry) {
+            return NULL;
+         }
+         icon = CreateIconFromFile(entry->fileName, save, preserveAspect);
+         if(icon) {
+            return icon;
+         }
+      }
+
       for(ip = iconPaths; ip; ip = ip->next) {
          icon = LoadNamedIconHelper(name, ip->path, save, preserveAspect);
          if(icon) {
@@ -305,6 +430,68 @@ IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect)
 
 }
 
+/** Decode an icon in the background so it is ready when loaded. */
+void PreloadIcon(const char *name)
+{
+   IconPathNode *pn;
+   if(!name || name[0] == 0) {
+      return;
+   }
+   if(preloadStarted) {
+      RequestIcon(name);
+   } else {
+      pn = Allocate(sizeof(IconPathNode));
+      pn->path = CopyString(name);
+      pn->next = preloadNames;
+      preloadNames = pn;
+   }
+}
+
+/** Queue the file LoadNamedIcon would load for a name.
+ * A placeholder without images is saved in the icon hash until the
+ * image is decoded; CreateIconFromFile waits for it if needed.
+ */
+void RequestIcon(const char *name)
+{
+   const char *fileName;
+   IconNode *icon;
+
+   UpdateIconIndex();
+   if(name[0] == '/') {
+      fileName = name;
+   } else if(iconIndex && !strchr(name, '/')) {
+      const IconIndexNode *entry = FindIconIndexEntry(name);
+      if(!entry) {
+         return;
+      }
+      fileName = entry->fileName;
+   } else {
+      return;
+   }
+
+   if(FindIcon(fileName)) {
+      return;
+   }
+   icon = CreateIcon();
+   icon->name = CopyString(fileName);
+   if(RequestImage(fileName, HandlePreloadedIcon, icon)) {
+      InsertIcon(icon);
+   } else {
+      DoDestroyIcon(NULL, icon);
+   }
+}
+
+/** Store a preloaded image in its placeholder icon. */
+void HandlePreloadedIcon(ImageNode *image, void *data)
+{
+   IconNode *icon = (IconNode*)data;
+   if(image) {
+      icon->images = image;
+   } else {
+      DoDestroyIcon(&iconHash[GetHash(icon->name)], icon);
+   }
+}
+
 /** Helper for loading icons by name. */
 IconNode *LoadNamedIconHelper(const char *name, const char *path,
                               char save, char preserveAspect)
@@ -333,23 +520,431 @@ IconNode *LoadNamedIconHelper(const char *name, const char *path,
    return result;
 }
 
-/** Read the icon property from a client. */
-void ReadNetWMIcon(ClientNode *np)
+/** Build an index of the files in the icon paths.
+ * The index maps each name LoadNamedIcon may be asked for to the file
+ * that the search over paths and extensions would find first.
+ */
+void CreateIconIndex(void)
 {
-   static const long MAX_LENGTH = 1 << 20;
-   unsigned long count;
-   int status;
+#ifdef HAVE_DIRENT_H
+   IconPathNode *ip;
+   unsigned pathIndex;
+   unsigned x;
+
+   iconIndex = Allocate(sizeof(IconIndexNode*) * INDEX_HASH_SIZE);
+   for(x = 0; x < INDEX_HASH_SIZE; x++) {
+      iconIndex[x] = NULL;
+   }
+
+#ifdef HAVE_SYS_INOTIFY_H
+   if(iconWatch < 0) {
+      iconWatch = inotify_init();
+      if(iconWatch >= 0) {
+         fcntl(iconWatch, F_SETFL, O_NONBLOCK);
+         fcntl(iconWatch, F_SETFD, FD_CLOEXEC);
+      }
+   }
+#endif
+
+   pathIndex = 0;
+   for(ip = iconPaths; ip; ip = ip->next) {
+      const unsigned pathLength = strlen(ip->path);
+      struct dirent *entry;
+      DIR *dir;
+
+#ifdef HAVE_SYS_INOTIFY_H
+      /* A missing path is picked up when a parent gets a new directory. */
+      ip->watch = -1;
+      if(iconWatch >= 0) {
+         ip->watch = inotify_add_watch(iconWatch, ip->path,
+                                       IN_CREATE | IN_DELETE | IN_MOVED_FROM
+                                       | IN_MOVED_TO | IN_DELETE_SELF
+                                       | IN_MOVE_SELF);
+         if(ip->watch < 0) {
+            WatchIconPathParent(ip->path);
+         }
+      }
+#endif
+
+      dir = opendir(ip->path);
+      if(dir) {
+         while((entry = readdir(dir)) != NULL) {
+            const unsigned nameLength = strlen(entry->d_name);
+            char *fileName;
+            if(entry->d_name[0] == '.') {
+               continue;
+            }
+            fileName = AllocateStack(pathLength + nameLength + 1);
+            memcpy(fileName, ip->path, pathLength);
+            memcpy(&fileName[pathLength], entry->d_name, nameLength + 1);
+
+            /* Match the name as given and with each extension removed. */
+            AddIconIndexEntry(entry->d_name, nameLength, fileName,
+                              pathIndex, 0);
+            for(x = 1; x < EXTENSION_COUNT; x++) {
+               const unsigned extLength = strlen(ICON_EXTENSIONS[x]);
+               if(nameLength > extLength
+                  && !strcmp(&entry->d_name[nameLength - extLength],
+                             ICON_EXTENSIONS[x])) {
+                  AddIconIndexEntry(entry->d_name, nameLength - extLength,
+                                    fileName, pathIndex, x);
+               }
+            }
+            ReleaseStack(fileName);
+         }
+         closedir(dir);
+      }
+      pathIndex += 1;
+   }
+#endif
+}
+
+/** Release the icon path index. */
+void DestroyIconIndex(void)
+{
+   unsigned x;
+   if(iconIndex) {
+      for(x = 0; x < INDEX_HASH_SIZE; x++) {
+         while(iconIndex[x]) {
+            IconIndexNode *next = iconIndex[x]->next;
+            Release(iconIndex[x]->name);
+            Release(iconIndex[x]->fileName);
+            Release(iconIndex[x]);
+            iconIndex[x] = next;
+         }
+      }
+      Release(iconIndex);
+      iconIndex = NULL;
+   }
+}
+
+/** Add a name to the icon path index, keeping the first match. */
+void AddIconIndexEntry(const char *name, unsigned nameLength,
+                       const char *fileName,
+                       unsigned pathIndex, unsigned extIndex)
+{
+   IconIndexNode *np;
+   unsigned int hash;
+   char *key;
+
+   key = Allocate(nameLength + 1);
+   memcpy(key, name, nameLength);
+   key[nameLength] = 0;
+   hash = GetStringHash(key) & (INDEX_HASH_SIZE - 1);
+
+   for(np = iconIndex[hash]; np; np = np->next) {
+      if(!strcmp(np->name, key)) {
+         if(pathIndex < np->pathIndex
+            || (pathIndex == np->pathIndex && extIndex < np->extIndex)) {
+            Release(np->fileName);
+            np->fileName = CopyString(fileName);
+            np->pathIndex = pathIndex;
+            np->extIndex = extIndex;
+         }
+         Release(key);
+         return;
+      }
+   }
+
+   np = Allocate(sizeof(IconIndexNode));
+   np->name = key;
+   np->fileName = CopyString(fileName);
+   np->pathIndex = pathIndex;
+   np->extIndex = extIndex;
+   np->next = iconIndex[hash];
+   iconIndex[hash] = np;
+}
+
+/** Look up a name in the icon path index. */
+const IconIndexNode *FindIconIndexEntry(const char *name)
+{
+   const unsigned int hash = GetStringHash(name) & (INDEX_HASH_SIZE - 1);
+   const IconIndexNode *np;
+   for(np = iconIndex[hash]; np; np = np->next) {
+      if(!strcmp(np->name, name)) {
+         return np;
+      }
+   }
+   return NULL;
+}
+
+/** Rebuild the icon path index if an icon directory changed. */
+void UpdateIconIndex(void)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+   union {
+      struct inotify_event event;
+      char data[4096];
+   } buffer;
+   ssize_t length;
+   char changed = 0;
+   if(iconWatch < 0) {
+      return;
+   }
+   while((length = read(iconWatch, buffer.data, sizeof(buffer.data))) > 0) {
+      ssize_t offset = 0;
+      while(offset < length) {
+         const struct inotify_event *event
+            = (const struct inotify_event*)&buffer.data[offset];
+         changed = changed || IsIconIndexEvent(event);
+         offset += sizeof(struct inotify_event) + event->len;
+      }
+   }
+   if(changed) {
+      DestroyIconIndex();
+      CreateIconIndex();
+   }
+#endif
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+/** Watch the nearest existing parent of a missing icon path. */
+void WatchIconPathParent(const char *path)
+{
+   const unsigned length = strlen(path);
+   char *parent = AllocateStack(length + 1);
+   int end = length;
+
+   memcpy(parent, path, length + 1);
+   for(;;) {
+
+      /* Remove the last component. */
+      while(end > 0 && parent[end - 1] == '/') {
+         end -= 1;
+      }
+      while(end > 0 && parent[end - 1] != '/') {
+         end -= 1;
+      }
+      if(end == 0) {
+         break;
+      }
+      parent[end > 1 ? end - 1 : end] = 0;
+
+      /* IN_MASK_ADD keeps the mask of a watch on another icon path. */
+      if(inotify_add_watch(iconWatch, parent,
+                           IN_CREATE | IN_MOVED_TO | IN_ONLYDIR
+                           | IN_MASK_ADD) >= 0) {
+         break;
+      }
+
+   }
+   ReleaseStack(parent);
+}
+
+/** Determine if an inotify event may change the icon path index.
+ * Events on the parents of missing paths only count for directories.
+ */
+char IsIconIndexEvent(const struct inotify_event *event)
+{
+   const IconPathNode *ip;
+   if(event->mask & (IN_ISDIR | IN_Q_OVERFLOW)) {
+      return 1;
+   }
+   for(ip = iconPaths; ip; ip = ip->next) {
+      if(ip->watch >= 0 && ip->watch == event->wd) {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+#endif /* HAVE_SYS_INOTIFY_H */
+
+/** Determine the size of _NET_WM_ICON images worth keeping.
+ * This is the largest size at which client icons are drawn: the title
+ * bar, the tray buttons, or the menus.
+ */
+unsigned long GetNetWMIconSize(void)
+{
+   TrayType *tp;
+   unsigned long size = Max(MIN_NET_WM_ICON_SIZE, settings.titleHeight);
+   for(tp = GetTrays(); tp; tp = tp->next) {
+      const unsigned long traySize = Min(tp->width, tp->height);
+      size = Max(size, traySize);
+   }
+   return size;
+}
+
+/** Read the size headers of the images in _NET_WM_ICON.
+ * Only the headers are transferred.
+ * @return The number of valid images found.
+ */
+unsigned int ReadNetWMIconHeaders(Window w, NetWMIconImage *images)
+{
+   unsigned int count = 0;
+   long offset = 0;
+   while(count < MAX_NET_WM_ICONS) {
+      unsigned long length;
+      unsigned long extra;
+      unsigned long pixels;
+      Atom realType;
+      int realFormat;
+      unsigned char *data;
+      int status;
+
+      status = JXGetWindowProperty(display, w, atoms[ATOM_NET_WM_ICON],
+                                   offset, 2, False, XA_CARDINAL,
+                                   &realType, &realFormat, &length, &extra,
+                                   &data);
+      if(status != Success || !data) {
+         break;
+      }
+      if(realFormat != 32 || length < 2) {
+         JXFree(data);
+         break;
+      }
+      images[count].offset = offset;
+      images[count].width = ((unsigned long*)data)[0] & 0xFFFFFFFFUL;
+      images[count].height = ((unsigned long*)data)[1] & 0xFFFFFFFFUL;
+      JXFree(data);
+
+      /* extra is the number of bytes after the header. */
+      if(JUNLIKELY(images[count].width == 0 || images[count].height == 0
+                   || images[count].width > 0xFFFF
+                   || images[count].height > 0xFFFF)) {
+         Debug("invalid image size: %lu x %lu",
+               images[count].width, images[count].height);
+         break;
+      }
+      pixels = images[count].width * images[count].height;
+      if(JUNLIKELY(pixels > extra / 4)) {
+         Debug("invalid image size: %lu x %lu > %lu",
+               images[count].width, images[count].height, extra / 4);
+         break;
+      }
+      count += 1;
+      if(pixels == extra / 4) {
+         break;
+      }
+      offset += 2 + pixels;
+   }
+   return count;
+}
+
+/** Read a range of _NET_WM_ICON into a buffer.
+ * @return 1 on success, 0 if the property could not be read.
+ */
+char ReadNetWMIconRange(Window w, long offset, unsigned long count,
+                        unsigned long *dest)
+{
+   unsigned long length;
    unsigned long extra;
+   unsigned char *data;
    Atom realType;
    int realFormat;
-   unsigned char *data;
-   status = JXGetWindowProperty(display, np->window, atoms[ATOM_NET_WM_ICON],
-                                0, MAX_LENGTH, False, XA_CARDINAL,
-                                &realType, &realFormat, &count, &extra, &data);
-   if(status == Success && realFormat != 0 && data) {
-      np->icon = CreateIconFromBinary((unsigned long*)data, count);
+   int status;
+
+   status = JXGetWindowProperty(display, w, atoms[ATOM_NET_WM_ICON],
+                                offset, count, False, XA_CARDINAL,
+                                &realType, &realFormat, &length, &extra,
+                                &data);
+   if(status != Success || !data) {
+      return 0;
+   }
+   if(realFormat != 32 || length != count) {
       JXFree(data);
+      return 0;
+   }
+   memcpy(dest, data, sizeof(unsigned long) * count);
+   JXFree(data);
+   return 1;
+}
+
+/** Read the icon property from a client.
+ * The size headers are read first and only the images that may be drawn
+ * are transferred: the smallest image at least as large as the largest
+ * size used, along with any smaller images. Adjacent selected images are
+ * fetched in one request.
+ */
+void ReadNetWMIcon(ClientNode *np)
+{
+   NetWMIconImage images[MAX_NET_WM_ICONS];
+   unsigned long *input;
+   unsigned long inputLength;
+   unsigned long runLength;
+   unsigned long limit;
+   unsigned long wanted;
+   long runStart;
+   unsigned int hash;
+   unsigned int count;
+   unsigned int x;
+
+   count = ReadNetWMIconHeaders(np->window, images);
+   if(count == 0) {
+      return;
+   }
+
+   /* Determine the largest image to keep. */
+   limit = GetNetWMIconSize();
+   wanted = 0;
+   for(x = 0; x < count; x++) {
+      const unsigned long size = Min(images[x].width, images[x].height);
+      const unsigned long area = images[x].width * images[x].height;
+      if(size >= limit && (wanted == 0 || area < wanted)) {
+         wanted = area;
+      }
+   }
+   if(wanted == 0) {
+      for(x = 0; x < count; x++) {
+         wanted = Max(wanted, images[x].width * images[x].height);
+      }
+   }
+
+   /* Determine the length of the selected images. */
+   inputLength = 0;
+   for(x = 0; x < count; x++) {
+      const unsigned long area = images[x].width * images[x].height;
+      if(area <= wanted) {
+         inputLength += 2 + area;
+      }
+   }
+   if(inputLength == 0) {
+      return;
+   }
+
+   /* Fetch each run of adjacent selected images.
+    * Images that are not selected are never transferred. */
+   input = Allocate(sizeof(unsigned long) * inputLength);
+   inputLength = 0;
+   runStart = 0;
+   runLength = 0;
+   for(x = 0; x <= count; x++) {
+      const char selected = x < count
+         && images[x].width * images[x].height <= wanted;
+      if(selected && runLength > 0
+         && images[x].offset == runStart + (long)runLength) {
+         runLength += 2 + images[x].width * images[x].height;
+         continue;
+      }
+      if(runLength > 0) {
+         if(!ReadNetWMIconRange(np->window, runStart, runLength,
+                                &input[inputLength])) {
+            Release(input);
+            return;
+         }
+         inputLength += runLength;
+         runLength = 0;
+      }
+      if(selected) {
+         runStart = images[x].offset;
+         runLength = 2 + images[x].width * images[x].height;
+      }
+   }
+
+   /* Share icons with identical data between clients.
+    * If the data is unchanged, this finds the current icon. */
+   hash = GetBinaryHash(input, inputLength);
+   np->icon = FindBinaryIcon(hash, input, inputLength);
+   if(np->icon) {
+      np->icon->refCount += 1;
+   } else {
+      np->icon = CreateIconFromBinary(input, inputLength);
+      if(np->icon) {
+         InsertBinaryIcon(np->icon, hash, input, inputLength);
+      }
    }
+   Release(input);
 }
 
 /** Read the icon WMHint property from a client. */
@@ -436,6 +1031,10 @@ IconNode *CreateIconFromFile(const char *fileName,
 
    /* Check if this icon has already been loaded */
    result = FindIcon(fileName);
+   if(result && JUNLIKELY(!result->images)) {
+      WaitForImage(fileName, HandlePreloadedIcon);
+      result = FindIcon(fileName);
+   }
    if(result) {
       return result;
    }
@@ -456,6 +1055,15 @@ IconNode *CreateIconFromFile(const char *fileName,
 
 }
 
+/** Create an icon from a loaded image. */
+IconNode *CreateIconFromImage(ImageNode *image, char preserveAspect)
+{
+   IconNode *result = CreateIcon();
+   result->preserveAspect = preserveAspect;
+   result->images = image;
+   return result;
+}
+
 /** Get the best image for the requested size. */
 ImageNode *GetBestImage(IconNode *icon, int rwidth, int rheight)
 {
@@ -505,9 +1113,10 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, ImageNode *iconImage,
 
    XColor color;
    XImage *image;
-   XPoint *points;
+   XImage *maskImage;
    ScaledIconNode *np;
    GC maskGC;
+   char direct;
    int x, y;
    int scalex, scaley;     /* Fixed point. */
    int srcx, srcy;         /* Fixed point. */
@@ -534,37 +1143,48 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, ImageNode *iconImage,
    nwidth = Max(1, nwidth);
    nheight = Max(1, nheight);
 
-   /* Check if this size already exists.
-    * Note that XRender scales on the fly.
-    */
+   /* Check if this size already exists. */
    for(np = iconImage->nodes; np; np = np->next) {
+      if(np->width == nwidth && np->height == nheight) {
 #ifdef USE_XRENDER
-      if(np->imagePicture != None) {
-         np->width = nwidth;
-         np->height = nheight;
-         return np;
-      }
+         /* Render icons are created once; the image data is gone. */
+         if(np->imagePicture != None) {
+            return np;
+         }
 #endif
-      if(np->width == nwidth && np->height == nheight) {
          if(!iconImage->bitmap || np->fg == fg) {
             return np;
          }
       }
    }
 
-   /* See if we can use XRender to create the icon. */
+   /* See if we can use XRender to create the icon.
+    * The full size icon is created first and the server then scales
+    * it once for each size requested.
+    */
 #ifdef USE_XRENDER
    if(haveRender) {
-      np = CreateScaledRenderIcon(iconImage, fg);
-
-      /* Don't keep the image data around after creating the icon. */
-      Release(iconImage->data);
-      iconImage->data = NULL;
-
-      np->width = nwidth;
-      np->height = nheight;
-
-      return np;
+      ScaledIconNode *base = NULL;
+      for(np = iconImage->nodes; np; np = np->next) {
+         if(np->width == iconImage->width && np->height == iconImage->height
+            && np->imagePicture != None) {
+            base = np;
+            break;
+         }
+      }
+      if(!base) {
+         base = CreateScaledRenderIcon(iconImage, fg);
+         base->width = iconImage->width;
+         base->height = iconImage->height;
+
+         /* Don't keep the image data around after creating the icon. */
+         Release(iconImage->data);
+         iconImage->data = NULL;
+      }
+      if(base->width == nwidth && base->height == nheight) {
+         return base;
+      }
+      return CreateScaledRenderCopy(iconImage, base, nwidth, nheight);
    }
 #endif
 
@@ -579,28 +1199,21 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, ImageNode *iconImage,
 #endif
    iconImage->nodes = np;
 
-   /* Create a mask. */
-   np->mask = JXCreatePixmap(display, rootWindow, nwidth, nheight, 1);
-   maskGC = JXCreateGC(display, np->mask, 0, NULL);
-   JXSetForeground(display, maskGC, 0);
-   JXFillRectangle(display, np->mask, maskGC, 0, 0, nwidth, nheight);
-   JXSetForeground(display, maskGC, 1);
-
-   /* Create a temporary XImage for scaling. */
-   image = JXCreateImage(display, rootVisual, rootDepth,
-                         ZPixmap, 0, NULL, nwidth, nheight, 8, 0);
-   image->data = Allocate(sizeof(unsigned long) * nwidth * nheight);
+   /* Create temporary XImages for scaling. */
+   image = CreateUploadImage(rootDepth, nwidth, nheight);
+   maskImage = CreateUploadImage(1, nwidth, nheight);
+   memset(maskImage->data, 0, maskImage->bytes_per_line * nheight);
+   direct = IsRGB32Image(image);
 
    /* Determine the scale factor. */
    scalex = (iconImage->width << 16) / nwidth;
    scaley = (iconImage->height << 16) / nheight;
 
-   points = Allocate(sizeof(XPoint) * nwidth);
    data = iconImage->data;
    srcy = 0;
    for(y = 0; y < nheight; y++) {
       const int yindex = (srcy >> 16) * iconImage->width;
-      int pindex = 0;
+      CARD32 *row = (CARD32*)(image->data + y * image->bytes_per_line);
       srcx = 0;
       for(x = 0; x < nwidth; x++) {
          if(iconImage->bitmap) {
@@ -608,48 +1221,51 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, ImageNode *iconImage,
             const int offset = index >> 3;
             const int mask = 1 << (index & 7);
             if(data[offset] & mask) {
-               points[pindex].x = x;
-               points[pindex].y = y;
                XPutPixel(image, x, y, fg);
-               pindex += 1;
+               XPutPixel(maskImage, x, y, 1);
             }
          } else {
-            const int yindex = (srcy >> 16) * iconImage->width;
-            const int index = 4 * (yindex + (srcx >> 16));
-            color.red = data[index + 1];
-            color.red |= color.red << 8;
-            color.green = data[index + 2];
-            color.green |= color.green << 8;
-            color.blue = data[index + 3];
-            color.blue |= color.blue << 8;
-            GetColor(&color, 0);
-            XPutPixel(image, x, y, color.pixel);
-            if(data[index] >= 128) {
-               points[pindex].x = x;
-               points[pindex].y = y;
-               pindex += 1;
+            const unsigned char *pixel = &data[4 * (yindex + (srcx >> 16))];
+            if(direct) {
+               /* Fast path: store 0xRRGGBB directly. */
+               row[x] = ((CARD32)pixel[1] << 16)
+                      | ((CARD32)pixel[2] << 8)
+                      | (CARD32)pixel[3];
+            } else {
+               color.red = pixel[1];
+               color.red |= color.red << 8;
+               color.green = pixel[2];
+               color.green |= color.green << 8;
+               color.blue = pixel[3];
+               color.blue |= color.blue << 8;
+               GetColor(&color, 0);
+               XPutPixel(image, x, y, color.pixel);
+            }
+            if(pixel[0] >= 128) {
+               XPutPixel(maskImage, x, y, 1);
             }
          }
          srcx += scalex;
       }
-      JXDrawPoints(display, np->mask, maskGC, points, pindex, CoordModeOrigin);
       srcy += scaley;
    }
-   Release(points);
 
-   /* Release the mask GC. */
+   /* Render the mask. */
+   np->mask = JXCreatePixmap(display, rootWindow, nwidth, nheight, 1);
+   maskGC = JXCreateGC(display, np->mask, 0, NULL);
+   PutUploadImage(np->mask, maskGC, maskImage, nwidth, nheight);
    JXFreeGC(display, maskGC);
- 
+   DestroyUploadImage(maskImage);
+
    /* Create the color data pixmap. */
    np->image = JXCreatePixmap(display, rootWindow, nwidth, nheight,
                               rootDepth);
 
    /* Render the image to the color data pixmap. */
-   JXPutImage(display, np->image, rootGC, image, 0, 0, 0, 0, nwidth, nheight);   
+   PutUploadImage(np->image, rootGC, image, nwidth, nheight);
+
    /* Release the XImage. */
-   Release(image->data);
-   image->data = NULL;
-   JXDestroyImage(image);
+   DestroyUploadImage(image);
 
    return np;
 
@@ -702,7 +1318,8 @@ IconNode *CreateIconFromBinary(const unsigned long *input,
          offset += 1;
       }
 
-      /* Don't insert this icon into the hash since it is transient. */
+      /* Don't insert this icon into the hash since it is transient.
+       * ReadNetWMIcon shares it by content instead. */
 
    }
 
@@ -719,11 +1336,15 @@ IconNode *CreateIcon(void)
    icon->next = NULL;
    icon->prev = NULL;
    icon->preserveAspect = 1;
+   icon->content = NULL;
+   icon->contentLength = 0;
+   icon->contentHash = 0;
+   icon->refCount = 0;
    return icon;
 }
 
 /** Helper method for destroy icons. */
-void DoDestroyIcon(int index, IconNode *icon)
+void DoDestroyIcon(IconNode **list, IconNode *icon)
 {
    if(icon && icon != &emptyIcon) {
       ImageNode *image = icon->images;
@@ -755,12 +1376,15 @@ void DoDestroyIcon(int index, IconNode *icon)
       if(icon->name) {
          Release(icon->name);
       }
+      if(icon->content) {
+         Release(icon->content);
+      }
       DestroyImage(icon->images);
 
       if(icon->prev) {
          icon->prev->next = icon->next;
-      } else {
-         iconHash[index] = icon->next;
+      } else if(list && *list == icon) {
+         *list = icon->next;
       }
       if(icon->next) {
          icon->next->prev = icon->prev;
@@ -773,8 +1397,15 @@ void DoDestroyIcon(int index, IconNode *icon)
 void DestroyIcon(IconNode *icon)
 {
    if(icon && !icon->name) {
-      const unsigned int index = GetHash(icon->name);
-      DoDestroyIcon(index, icon);
+      if(icon->content) {
+         icon->refCount -= 1;
+         if(icon->refCount == 0) {
+            DoDestroyIcon(&binaryHash[icon->contentHash & (HASH_SIZE - 1)],
+                          icon);
+         }
+      } else {
+         DoDestroyIcon(NULL, icon);
+      }
    }
 }
 
@@ -822,4 +1453,58 @@ unsigned int GetHash(const char *str)
    return hash;
 }
 
+/** Get a hash for _NET_WM_ICON data. */
+unsigned int GetBinaryHash(const unsigned long *data, unsigned int length)
+{
+   unsigned int hash = length;
+   unsigned int x;
+   for(x = 0; x < length; x++) {
+      hash = (hash + (hash << 5)) ^ (unsigned int)(data[x] & 0xFFFFFFFFUL);
+   }
+   return hash;
+}
+
+/** Find a shared icon with the specified _NET_WM_ICON data. */
+IconNode *FindBinaryIcon(unsigned int hash, const unsigned long *data,
+                         unsigned int length)
+{
+   IconNode *icon = binaryHash[hash & (HASH_SIZE - 1)];
+   while(icon) {
+      if(icon->contentHash == hash && icon->contentLength == length) {
+         unsigned int x;
+         for(x = 0; x < length; x++) {
+            if(icon->content[x] != (CARD32)data[x]) {
+               break;
+            }
+         }
+         if(x == length) {
+            return icon;
+         }
+      }
+      icon = icon->next;
+   }
+   return NULL;
+}
+
+/** Insert an icon created from _NET_WM_ICON data for sharing. */
+void InsertBinaryIcon(IconNode *icon, unsigned int hash,
+                      const unsigned long *data, unsigned int length)
+{
+   const unsigned int index = hash & (HASH_SIZE - 1);
+   unsigned int x;
+   icon->content = Allocate(sizeof(CARD32) * length);
+   for(x = 0; x < length; x++) {
+      icon->content[x] = (CARD32)data[x];
+   }
+   icon->contentLength = length;
+   icon->contentHash = hash;
+   icon->refCount = 1;
+   icon->prev = NULL;
+   if(binaryHash[index]) {
+      binaryHash[index]->prev = icon;
+   }
+   icon->next = binaryHash[index];
+   binaryHash[index] = icon;
+}
+
 #endif /* USE_ICONS */
@@ -42,6 +42,11 @@ typedef struct IconNode {
    char preserveAspect;           /**< Set to preserve the aspect ratio
                                    *   of the icon when scaling. */
 
+   CARD32 *content;               /**< _NET_WM_ICON data for shared icons. */
+   unsigned int contentLength;    /**< Length of content in CARD32s. */
+   unsigned int contentHash;      /**< Hash of content. */
+   unsigned int refCount;         /**< Clients using a shared icon. */
+
 } IconNode;
 
 extern IconNode emptyIcon;
@@ -88,6 +93,20 @@ void LoadIcon(struct ClientNode *np);
  */
 IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect);
 
+/** Start decoding an icon that will be loaded with LoadNamedIcon.
+ * Names given before StartupIcons are queued until the icon paths are
+ * indexed.
+ * @param name The name of the icon.
+ */
+void PreloadIcon(const char *name);
+
+/** Create an icon from a loaded image.
+ * @param image The image, which is now owned by the icon.
+ * @param preserveAspect Set to preserve the aspect ratio when scaling.
+ * @return A new icon to be released with DestroyIcon.
+ */
+IconNode *CreateIconFromImage(struct ImageNode *image, char preserveAspect);
+
 /** Destroy an icon.
  * @param icon The icon to destroy.
  */
@@ -105,6 +124,8 @@ void DestroyIcon(IconNode *icon);
 #define PutIcon( a, b, c, d, e, f, g, h )  ICON_DUMMY_FUNCTION
 #define LoadIcon( a )                      ICON_DUMMY_FUNCTION
 #define LoadNamedIcon( a, b, c )           NULL
+#define PreloadIcon( a )                   ICON_DUMMY_FUNCTION
+#define CreateIconFromImage( a, b )        NULL
 #define DestroyIcon( a )                   ICON_DUMMY_FUNCTION
 
 #endif /* USE_ICONS */
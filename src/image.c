@@ -9,10 +9,23 @@
 
 #include "jwm.h"
 
+/* Images are decoded on worker threads if we have pthreads.
+ * The debug allocator is not thread safe.
+ */
+#if defined(USE_THREADS) && defined(USE_ICONS) && !defined(DEBUG) \
+   && defined(HAVE_FCNTL_H) && defined(HAVE_UNISTD_H) \
+   && defined(HAVE_SIGNAL_H)
+#  define USE_IMAGE_WORKER
+#endif
+
 #ifndef MAKE_DEPEND
 
    /* We should include png.h here. See jwm.h for an explanation. */
 
+#  ifdef USE_IMAGE_WORKER
+#     include <pthread.h>
+#  endif
+
 #  ifdef USE_XPM
 #     include <X11/xpm.h>
 #  endif
@@ -55,6 +68,165 @@ static ImageNode *LoadXBMImage(const char *fileName);
 static ImageNode *CreateImageFromXImages(XImage *image, XImage *shape);
 #endif
 
+/* Decoded images are cached on disk if we can map files. */
+#if defined(HAVE_SYS_STAT_H) && defined(HAVE_SYS_MMAN_H) \
+   && defined(HAVE_FCNTL_H) && defined(HAVE_UNISTD_H)
+#  define USE_IMAGE_CACHE
+#endif
+
+#ifdef USE_IMAGE_CACHE
+
+/** Version of the image cache format. */
+#define IMAGE_CACHE_VERSION 1
+
+/** Maximum total size of the image cache in bytes.
+ * Larger images are not cached.
+ */
+#define MAX_IMAGE_CACHE_SIZE (128UL * 1024UL * 1024UL)
+
+/** Header of an image cache file.
+ * The header is followed by the source path and then the image data.
+ */
+typedef struct ImageCacheHeader {
+   char magic[4];             /**< "JWMI" */
+   unsigned int version;      /**< IMAGE_CACHE_VERSION */
+   unsigned int headerSize;   /**< sizeof(ImageCacheHeader) */
+   unsigned int width;        /**< Image width. */
+   unsigned int height;       /**< Image height. */
+   unsigned int pathLength;   /**< Length of the source path. */
+   long mtime;                /**< Modification time of the source. */
+   long size;                 /**< Size of the source. */
+} ImageCacheHeader;
+
+/** A file in the image cache directory. */
+typedef struct ImageCacheEntry {
+   char *path;
+   time_t used;               /**< Last access or modification time. */
+   unsigned long size;
+} ImageCacheEntry;
+
+/** Directory of the image cache (NULL if not available).
+ * This is set up by StartupImages since the environment may not be
+ * read from the decode threads while the clock changes TZ.
+ */
+static char *imageCacheDir = NULL;
+
+static void CreateImageCacheDir(void);
+static void PruneImageCache(void);
+static int ImageCacheEntryComparator(const void *a, const void *b);
+static char *GetImageCachePath(const char *fileName);
+static ImageNode *LoadCachedImage(const char *fileName,
+                                  const struct stat *sb);
+static void SaveCachedImage(const char *fileName, const struct stat *sb,
+                            const ImageNode *image);
+
+#endif /* USE_IMAGE_CACHE */
+
+static ImageNode *DecodeImage(const char *fileName);
+
+/** Bits of precision in scale filter weights. */
+#define SCALE_SHIFT 14
+
+/** Minimum number of rows per band when scaling on several threads. */
+#define SCALE_MIN_BAND 32
+
+/** Filter taps for each output column or row of a scaled image. */
+typedef struct ScaleFilter {
+   int *index;       /**< Source index for each tap. */
+   int *weights;     /**< Weight of each tap (sums to 1 << SCALE_SHIFT). */
+   int taps;         /**< Number of taps per output column or row. */
+} ScaleFilter;
+
+/** A band of rows of a scaled image. */
+typedef struct ScaleBand {
+   const ImageNode *source;
+   ImageNode *dest;
+   const ScaleFilter *xfilter;
+   const ScaleFilter *yfilter;
+   int firstRow;
+   int lastRow;
+} ScaleBand;
+
+static ImageNode *ExpandBitmap(const ImageNode *image);
+static void CreateScaleFilter(ScaleFilter *filter, int srcSize, int dstSize);
+static void DestroyScaleFilter(ScaleFilter *filter);
+static void ScaleImageBand(const ScaleBand *band);
+static void FilterScaleRow(const ScaleBand *band, int row,
+                           unsigned short *out);
+static unsigned int GetScaleBandCount(int height);
+
+#ifdef USE_IMAGE_WORKER
+
+/** Maximum number of decode threads. */
+#define MAX_IMAGE_THREADS 8
+
+/** Request to decode an image on a worker thread. */
+typedef struct ImageRequest {
+   char *fileName;               /**< The file to load. */
+   ImageNode *image;             /**< The result. */
+   ImageCallback callback;       /**< Function to receive the result. */
+   int width;                    /**< Size to scale to (0 for none). */
+   int height;
+   char preserveAspect;          /**< Set to preserve the aspect ratio. */
+   void *data;                   /**< Data for the callback. */
+   struct ImageRequest *next;    /**< Next request in the queue. */
+} ImageRequest;
+
+/** Queue of image requests. */
+typedef struct ImageQueue {
+   ImageRequest *head;
+   ImageRequest *tail;
+} ImageQueue;
+
+/** Bands of an image being scaled on the decode threads. */
+typedef struct ScaleJob {
+   ScaleBand *bands;
+   unsigned int count;           /**< Number of bands. */
+   unsigned int started;         /**< Number of bands taken. */
+   unsigned int finished;        /**< Number of bands done. */
+   struct ScaleJob *next;        /**< Next job with bands to take. */
+} ScaleJob;
+
+/** The worker threads and their queues.
+ * The queues, scaleJobs, and imageThreadExit are protected by imageMutex.
+ * Requests move from pending to active to finished.
+ * Bands of scale jobs are taken before new requests.
+ */
+static pthread_t imageThreads[MAX_IMAGE_THREADS];
+static unsigned int imageThreadCount = 0;
+static pthread_mutex_t imageMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t imageCondition = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t imageFinished = PTHREAD_COND_INITIALIZER;
+static ImageQueue pendingRequests;
+static ImageQueue activeRequests;
+static ImageQueue finishedRequests;
+static pthread_cond_t scaleFinished = PTHREAD_COND_INITIALIZER;
+static ScaleJob *scaleJobs;
+static char imageThreadExit;
+
+/** Pipe written by the workers when a request is finished. */
+static int imagePipe[2];
+
+static void *ImageThread(void *arg);
+static ScaleBand *TakeScaleBand(ScaleJob **job);
+static void FinishScaleBand(ScaleJob *job);
+static void RunScaleJob(ScaleBand *bands, unsigned int count);
+static unsigned int GetProcessorCount(void);
+static void PushImageRequest(ImageQueue *queue, ImageRequest *rp);
+static void RemoveImageRequest(ImageQueue *queue, ImageRequest *rp);
+static char IsImageRequest(const ImageRequest *rp, const char *fileName,
+                           ImageCallback callback);
+static ImageRequest *TakeImageRequests(ImageQueue *queue,
+                                       const char *fileName,
+                                       ImageCallback callback);
+static char HasImageRequest(const ImageQueue *queue, const char *fileName,
+                            ImageCallback callback);
+static void RunImageRequest(ImageRequest *rp);
+static void RunImageRequests(ImageRequest *rp);
+static void ReleaseImageRequests(ImageRequest *rp);
+
+#endif /* USE_IMAGE_WORKER */
+
 #ifdef USE_XPM
 static int AllocateColor(Display *d, Colormap cmap, char *name,
                          XColor *c, void *closure);
@@ -62,10 +234,478 @@ static int FreeColors(Display *d, Colormap cmap, Pixel *pixels, int n,
                       void *closure);
 #endif
 
-/** Load an image from the specified file. */
+/** Start the image decode threads.
+ * One thread is started per processor.
+ */
+void StartupImages(void)
+{
+#ifdef USE_IMAGE_CACHE
+   CreateImageCacheDir();
+   PruneImageCache();
+#endif
+#ifdef USE_IMAGE_WORKER
+   sigset_t mask;
+   sigset_t oldMask;
+   unsigned int count;
+   int i;
+
+   if(pipe(imagePipe) != 0) {
+      Debug("could not create image pipe");
+      return;
+   }
+   for(i = 0; i < 2; i++) {
+      fcntl(imagePipe[i], F_SETFD, FD_CLOEXEC);
+      fcntl(imagePipe[i], F_SETFL, O_NONBLOCK);
+   }
+
+   memset(&pendingRequests, 0, sizeof(pendingRequests));
+   memset(&activeRequests, 0, sizeof(activeRequests));
+   memset(&finishedRequests, 0, sizeof(finishedRequests));
+   scaleJobs = NULL;
+   imageThreadExit = 0;
+
+   count = GetProcessorCount();
+
+   /* Signals are handled by the event thread. */
+   sigfillset(&mask);
+   pthread_sigmask(SIG_SETMASK, &mask, &oldMask);
+   for(imageThreadCount = 0; imageThreadCount < count; imageThreadCount++) {
+      if(pthread_create(&imageThreads[imageThreadCount], NULL,
+                        ImageThread, NULL) != 0) {
+         break;
+      }
+   }
+   pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+
+   if(JUNLIKELY(imageThreadCount == 0)) {
+      Debug("could not create image threads");
+      close(imagePipe[0]);
+      close(imagePipe[1]);
+   }
+#endif
+}
+
+/** Stop the image decode threads.
+ * This waits for the images being decoded and discards all requests.
+ */
+void ShutdownImages(void)
+{
+#ifdef USE_IMAGE_WORKER
+   unsigned int i;
+
+   if(imageThreadCount == 0) {
+      return;
+   }
+
+   pthread_mutex_lock(&imageMutex);
+   imageThreadExit = 1;
+   pthread_cond_broadcast(&imageCondition);
+   pthread_mutex_unlock(&imageMutex);
+   for(i = 0; i < imageThreadCount; i++) {
+      pthread_join(imageThreads[i], NULL);
+   }
+   imageThreadCount = 0;
+
+   ReleaseImageRequests(pendingRequests.head);
+   ReleaseImageRequests(finishedRequests.head);
+
+   close(imagePipe[0]);
+   close(imagePipe[1]);
+#endif
+#ifdef USE_IMAGE_CACHE
+   if(imageCacheDir) {
+      Release(imageCacheDir);
+      imageCacheDir = NULL;
+   }
+#endif
+}
+
+/** Queue an image to be decoded on a worker thread. */
+char RequestImage(const char *fileName, ImageCallback callback, void *data)
+{
+   return RequestScaledImage(fileName, 0, 0, 0, callback, data);
+}
+
+/** Queue an image to be decoded and scaled on a worker thread. */
+char RequestScaledImage(const char *fileName,
+                        int width, int height, char preserveAspect,
+                        ImageCallback callback, void *data)
+{
+#ifdef USE_IMAGE_WORKER
+   ImageRequest *rp;
+   unsigned nameLength;
+
+   if(imageThreadCount == 0 || !fileName) {
+      return 0;
+   }
+
+   /* XPM and XBM images are loaded with Xlib. */
+   nameLength = strlen(fileName);
+   if(nameLength >= 4
+      && (   !StrCmpNoCase(&fileName[nameLength - 4], ".xpm")
+          || !StrCmpNoCase(&fileName[nameLength - 4], ".xbm"))) {
+      return 0;
+   }
+
+   rp = Allocate(sizeof(ImageRequest));
+   rp->fileName = CopyString(fileName);
+   rp->image = NULL;
+   rp->callback = callback;
+   rp->data = data;
+   rp->width = width;
+   rp->height = height;
+   rp->preserveAspect = preserveAspect;
+
+   pthread_mutex_lock(&imageMutex);
+   PushImageRequest(&pendingRequests, rp);
+   pthread_cond_signal(&imageCondition);
+   pthread_mutex_unlock(&imageMutex);
+   return 1;
+#else
+   return 0;
+#endif
+}
+
+/** Wait for the requests for a file with the specified callback. */
+void WaitForImage(const char *fileName, ImageCallback callback)
+{
+#ifdef USE_IMAGE_WORKER
+   ImageRequest *waiting;
+   ImageRequest *finished;
+   ImageRequest *rp;
+
+   if(imageThreadCount == 0) {
+      return;
+   }
+
+   /* Requests that have not started are decoded here instead of
+    * waiting for the requests queued ahead of them. */
+   pthread_mutex_lock(&imageMutex);
+   waiting = TakeImageRequests(&pendingRequests, fileName, callback);
+   while(HasImageRequest(&activeRequests, fileName, callback)) {
+      pthread_cond_wait(&imageFinished, &imageMutex);
+   }
+   finished = TakeImageRequests(&finishedRequests, fileName, callback);
+   pthread_mutex_unlock(&imageMutex);
+
+   for(rp = waiting; rp; rp = rp->next) {
+      RunImageRequest(rp);
+   }
+   RunImageRequests(waiting);
+   RunImageRequests(finished);
+#endif
+}
+
+/** Get the file descriptor signaled by the decode threads. */
+int GetImageEventFd(void)
+{
+#ifdef USE_IMAGE_WORKER
+   if(imageThreadCount > 0) {
+      return imagePipe[0];
+   }
+#endif
+   return -1;
+}
+
+/** Hand decoded images to their callbacks. */
+void ProcessImageEvents(void)
+{
+#ifdef USE_IMAGE_WORKER
+   ImageRequest *rp;
+   char buffer[32];
+
+   if(imageThreadCount == 0) {
+      return;
+   }
+
+   while(read(imagePipe[0], buffer, sizeof(buffer)) > 0);
+
+   pthread_mutex_lock(&imageMutex);
+   rp = finishedRequests.head;
+   finishedRequests.head = NULL;
+   finishedRequests.tail = NULL;
+   pthread_mutex_unlock(&imageMutex);
+
+   RunImageRequests(rp);
+#endif
+}
+
+#ifdef USE_IMAGE_WORKER
+
+/** Decode requested images until asked to exit.
+ * Only the decoders that do not need the display are used here.
+ */
+void *ImageThread(void *arg)
+{
+   pthread_mutex_lock(&imageMutex);
+   for(;;) {
+      ImageRequest *rp;
+      ScaleJob *job;
+      ScaleBand *band;
+
+      while(!pendingRequests.head && !scaleJobs && !imageThreadExit) {
+         pthread_cond_wait(&imageCondition, &imageMutex);
+      }
+      if(imageThreadExit) {
+         break;
+      }
+
+      /* Help scale images already decoded before starting another. */
+      band = TakeScaleBand(&job);
+      if(band) {
+         pthread_mutex_unlock(&imageMutex);
+         ScaleImageBand(band);
+         pthread_mutex_lock(&imageMutex);
+         FinishScaleBand(job);
+         continue;
+      }
+
+      rp = pendingRequests.head;
+      pendingRequests.head = rp->next;
+      if(!pendingRequests.head) {
+         pendingRequests.tail = NULL;
+      }
+      PushImageRequest(&activeRequests, rp);
+      pthread_mutex_unlock(&imageMutex);
+
+      RunImageRequest(rp);
+
+      pthread_mutex_lock(&imageMutex);
+      RemoveImageRequest(&activeRequests, rp);
+      PushImageRequest(&finishedRequests, rp);
+      pthread_cond_broadcast(&imageFinished);
+      if(write(imagePipe[1], "", 1) < 0) {
+         /* The pipe is full, so the event loop will wake up anyway. */
+      }
+   }
+   pthread_mutex_unlock(&imageMutex);
+   return NULL;
+}
+
+/** Append a request to a queue. */
+void PushImageRequest(ImageQueue *queue, ImageRequest *rp)
+{
+   rp->next = NULL;
+   if(queue->tail) {
+      queue->tail->next = rp;
+   } else {
+      queue->head = rp;
+   }
+   queue->tail = rp;
+}
+
+/** Remove a request from a queue. */
+void RemoveImageRequest(ImageQueue *queue, ImageRequest *rp)
+{
+   ImageRequest *prev = NULL;
+   ImageRequest *np = queue->head;
+   while(np != rp) {
+      prev = np;
+      np = np->next;
+   }
+   if(prev) {
+      prev->next = rp->next;
+   } else {
+      queue->head = rp->next;
+   }
+   if(queue->tail == rp) {
+      queue->tail = prev;
+   }
+}
+
+/** Load (and scale) the image for a request. */
+void RunImageRequest(ImageRequest *rp)
+{
+   rp->image = LoadImage(rp->fileName);
+   if(rp->image && rp->width > 0 && rp->height > 0) {
+      ImageNode *scaled = ScaleImage(rp->image, rp->width, rp->height,
+                                     rp->preserveAspect);
+      DestroyImage(rp->image);
+      rp->image = scaled;
+   }
+}
+
+/** Take a band to scale from the first scale job.
+ * This must be called with imageMutex held.
+ * @param job Set to the job owning the band.
+ * @return The band or NULL if there are no bands to take.
+ */
+ScaleBand *TakeScaleBand(ScaleJob **job)
+{
+   ScaleJob *jp = scaleJobs;
+   ScaleBand *band;
+   if(!jp) {
+      return NULL;
+   }
+   band = &jp->bands[jp->started];
+   jp->started += 1;
+   if(jp->started == jp->count) {
+      scaleJobs = jp->next;
+   }
+   *job = jp;
+   return band;
+}
+
+/** Mark a band of a scale job as done.
+ * This must be called with imageMutex held.
+ */
+void FinishScaleBand(ScaleJob *job)
+{
+   job->finished += 1;
+   if(job->finished == job->count) {
+      pthread_cond_broadcast(&scaleFinished);
+   }
+}
+
+/** Scale bands on the decode threads.
+ * The calling thread takes bands as well, so the job finishes even if
+ * every decode thread is busy.
+ */
+void RunScaleJob(ScaleBand *bands, unsigned int count)
+{
+   ScaleJob job;
+   ScaleJob **jp;
+
+   job.bands = bands;
+   job.count = count;
+   job.started = 0;
+   job.finished = 0;
+   job.next = NULL;
+
+   pthread_mutex_lock(&imageMutex);
+   for(jp = &scaleJobs; *jp; jp = &(*jp)->next);
+   *jp = &job;
+   pthread_cond_broadcast(&imageCondition);
+   while(job.started < job.count) {
+
+      /* Take bands from this job only: a band from another job could
+       * take much longer than the bands left here. */
+      ScaleBand *band = &job.bands[job.started];
+      job.started += 1;
+      if(job.started == job.count) {
+         for(jp = &scaleJobs; *jp != &job; jp = &(*jp)->next);
+         *jp = job.next;
+      }
+      pthread_mutex_unlock(&imageMutex);
+      ScaleImageBand(band);
+      pthread_mutex_lock(&imageMutex);
+      FinishScaleBand(&job);
+
+   }
+   while(job.finished < job.count) {
+      pthread_cond_wait(&scaleFinished, &imageMutex);
+   }
+   pthread_mutex_unlock(&imageMutex);
+}
+
+/** Determine if a request is for a file with the specified callback. */
+char IsImageRequest(const ImageRequest *rp, const char *fileName,
+                    ImageCallback callback)
+{
+   return rp->callback == callback && !strcmp(rp->fileName, fileName);
+}
+
+/** Remove requests for a file with the specified callback from a queue.
+ * Requests are returned in queue order.
+ */
+ImageRequest *TakeImageRequests(ImageQueue *queue, const char *fileName,
+                                ImageCallback callback)
+{
+   ImageQueue result;
+   ImageQueue rest;
+   ImageRequest *rp;
+
+   memset(&result, 0, sizeof(result));
+   memset(&rest, 0, sizeof(rest));
+   rp = queue->head;
+   while(rp) {
+      ImageRequest *next = rp->next;
+      PushImageRequest(IsImageRequest(rp, fileName, callback)
+                       ? &result : &rest, rp);
+      rp = next;
+   }
+   *queue = rest;
+   return result.head;
+}
+
+/** Determine if a queue has a request for a file with a callback. */
+char HasImageRequest(const ImageQueue *queue, const char *fileName,
+                     ImageCallback callback)
+{
+   const ImageRequest *rp;
+   for(rp = queue->head; rp; rp = rp->next) {
+      if(IsImageRequest(rp, fileName, callback)) {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+/** Run the callbacks for a list of finished requests. */
+void RunImageRequests(ImageRequest *rp)
+{
+   while(rp) {
+      ImageRequest *next = rp->next;
+      (rp->callback)(rp->image, rp->data);
+      Release(rp->fileName);
+      Release(rp);
+      rp = next;
+   }
+}
+
+/** Release a list of requests without running their callbacks. */
+void ReleaseImageRequests(ImageRequest *rp)
+{
+   while(rp) {
+      ImageRequest *next = rp->next;
+      if(rp->image) {
+         DestroyImage(rp->image);
+      }
+      Release(rp->fileName);
+      Release(rp);
+      rp = next;
+   }
+}
+
+#endif /* USE_IMAGE_WORKER */
+
+/** Load an image from the specified file.
+ * Decoded images are kept in an on-disk cache keyed by path, size and
+ * modification time so that later starts can skip the decoders.
+ */
 ImageNode *LoadImage(const char *fileName)
 {
-   const unsigned nameLength = strlen(fileName);
+#ifdef USE_IMAGE_CACHE
+   struct stat sb;
+   ImageNode *result;
+
+   if(!fileName) {
+      return NULL;
+   }
+
+   /* Skip files that do not exist without trying each decoder. */
+   if(stat(fileName, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+      return NULL;
+   }
+
+   result = LoadCachedImage(fileName, &sb);
+   if(result) {
+      return result;
+   }
+   result = DecodeImage(fileName);
+   if(result && !result->bitmap && !result->next) {
+      SaveCachedImage(fileName, &sb, result);
+   }
+   return result;
+#else
+   return DecodeImage(fileName);
+#endif
+}
+
+/** Decode an image from the specified file. */
+ImageNode *DecodeImage(const char *fileName)
+{
+   const unsigned nameLength = fileName ? strlen(fileName) : 0;
    ImageNode *result = NULL;
    if(!fileName) {
       return result;
@@ -130,6 +770,269 @@ ImageNode *LoadImage(const char *fileName)
 
 }
 
+#ifdef USE_IMAGE_CACHE
+
+/** Determine the cache directory and create it if needed.
+ * The cache lives in $XDG_CACHE_HOME/jwm (~/.cache/jwm by default).
+ */
+void CreateImageCacheDir(void)
+{
+   static const char CACHE_DIR[] = "/jwm";
+   const char *base;
+   unsigned baseLength;
+   char *home = NULL;
+
+   base = getenv("XDG_CACHE_HOME");
+   if(!base || base[0] != '/') {
+      base = getenv("HOME");
+      if(!base || base[0] != '/') {
+         return;
+      }
+      baseLength = strlen(base);
+      home = Allocate(baseLength + sizeof("/.cache"));
+      memcpy(home, base, baseLength);
+      memcpy(&home[baseLength], "/.cache", sizeof("/.cache"));
+      base = home;
+   }
+   baseLength = strlen(base);
+
+   imageCacheDir = Allocate(baseLength + sizeof(CACHE_DIR));
+   memcpy(imageCacheDir, base, baseLength + 1);
+   mkdir(imageCacheDir, 0700);
+   memcpy(&imageCacheDir[baseLength], CACHE_DIR, sizeof(CACHE_DIR));
+   mkdir(imageCacheDir, 0700);
+
+   if(home) {
+      Release(home);
+   }
+}
+
+/** Remove the least recently used images from the cache.
+ * Entries are removed until the cache fits in MAX_IMAGE_CACHE_SIZE,
+ * which also drops the entries of files that were renamed or deleted.
+ */
+void PruneImageCache(void)
+{
+#ifdef HAVE_DIRENT_H
+   ImageCacheEntry *entries = NULL;
+   unsigned long total = 0;
+   unsigned int maxEntries = 0;
+   unsigned int count = 0;
+   unsigned int i;
+   unsigned dirLength;
+   struct dirent *entry;
+   DIR *dir;
+
+   if(!imageCacheDir) {
+      return;
+   }
+   dir = opendir(imageCacheDir);
+   if(!dir) {
+      return;
+   }
+   dirLength = strlen(imageCacheDir);
+   while((entry = readdir(dir)) != NULL) {
+      const unsigned nameLength = strlen(entry->d_name);
+      struct stat sb;
+      char *path;
+      if(nameLength < 4 || strcmp(&entry->d_name[nameLength - 4], ".img")) {
+         continue;
+      }
+      path = Allocate(dirLength + nameLength + 2);
+      sprintf(path, "%s/%s", imageCacheDir, entry->d_name);
+      if(stat(path, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+         Release(path);
+         continue;
+      }
+      if(count == maxEntries) {
+         if(entries) {
+            maxEntries *= 2;
+            entries = Reallocate(entries,
+                                 sizeof(ImageCacheEntry) * maxEntries);
+         } else {
+            maxEntries = 16;
+            entries = Allocate(sizeof(ImageCacheEntry) * maxEntries);
+         }
+      }
+      entries[count].path = path;
+      entries[count].used = Max(sb.st_atime, sb.st_mtime);
+      entries[count].size = (unsigned long)sb.st_size;
+      total += entries[count].size;
+      count += 1;
+   }
+   closedir(dir);
+
+   if(total > MAX_IMAGE_CACHE_SIZE) {
+      qsort(entries, count, sizeof(ImageCacheEntry),
+            ImageCacheEntryComparator);
+      for(i = 0; i < count && total > MAX_IMAGE_CACHE_SIZE; i++) {
+         if(unlink(entries[i].path) == 0) {
+            total -= entries[i].size;
+         }
+      }
+   }
+
+   for(i = 0; i < count; i++) {
+      Release(entries[i].path);
+   }
+   if(entries) {
+      Release(entries);
+   }
+#endif
+}
+
+/** Comparator to sort cache entries from least to most recently used. */
+int ImageCacheEntryComparator(const void *a, const void *b)
+{
+   const ImageCacheEntry *ea = (const ImageCacheEntry*)a;
+   const ImageCacheEntry *eb = (const ImageCacheEntry*)b;
+   if(ea->used < eb->used) {
+      return -1;
+   } else if(ea->used > eb->used) {
+      return 1;
+   } else {
+      return 0;
+   }
+}
+
+/** Get the name of the cache file for an image.
+ * @param fileName The source image.
+ * @return The cache file name (to be released) or NULL.
+ */
+char *GetImageCachePath(const char *fileName)
+{
+   unsigned dirLength;
+   char *path;
+
+   if(!imageCacheDir) {
+      return NULL;
+   }
+
+   /* dir + "/" + 8 hex digits + ".img" */
+   dirLength = strlen(imageCacheDir);
+   path = Allocate(dirLength + 1 + 8 + 4 + 1);
+   sprintf(path, "%s/%08x.img", imageCacheDir, GetStringHash(fileName));
+   return path;
+}
+
+/** Load an image from the on-disk cache. */
+ImageNode *LoadCachedImage(const char *fileName, const struct stat *sb)
+{
+   const unsigned pathLength = strlen(fileName);
+   const ImageCacheHeader *header;
+   ImageNode *result = NULL;
+   struct stat cacheStat;
+   unsigned long dataSize;
+   char *cachePath;
+   char *map;
+   int fd;
+
+   cachePath = GetImageCachePath(fileName);
+   if(!cachePath) {
+      return NULL;
+   }
+   fd = open(cachePath, O_RDONLY);
+   Release(cachePath);
+   if(fd < 0) {
+      return NULL;
+   }
+   if(fstat(fd, &cacheStat) != 0
+      || cacheStat.st_size < (off_t)(sizeof(ImageCacheHeader) + pathLength)) {
+      close(fd);
+      return NULL;
+   }
+   map = mmap(NULL, cacheStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if(map == MAP_FAILED) {
+      return NULL;
+   }
+
+   /* Make sure the entry is for this version of this file.
+    * The size is checked before it is used since the file may be
+    * corrupt, and the data size must not wrap around.
+    */
+   header = (const ImageCacheHeader*)map;
+   if(!memcmp(header->magic, "JWMI", 4)
+      && header->version == IMAGE_CACHE_VERSION
+      && header->headerSize == sizeof(ImageCacheHeader)
+      && header->pathLength == pathLength
+      && header->mtime == (long)sb->st_mtime
+      && header->size == (long)sb->st_size
+      && header->width > 0 && header->width <= 0xFFFF
+      && header->height > 0 && header->height <= 0xFFFF
+      && header->height <= UINT_MAX / 4 / header->width) {
+      dataSize = 4UL * header->width * header->height;
+      if(cacheStat.st_size == (off_t)(sizeof(ImageCacheHeader)
+                                      + pathLength + dataSize)
+         && !memcmp(&map[sizeof(ImageCacheHeader)], fileName, pathLength)) {
+         result = CreateImage(header->width, header->height, 0);
+         memcpy(result->data, &map[sizeof(ImageCacheHeader) + pathLength],
+                dataSize);
+      }
+   }
+
+   munmap(map, cacheStat.st_size);
+   return result;
+}
+
+/** Save a decoded image to the on-disk cache. */
+void SaveCachedImage(const char *fileName, const struct stat *sb,
+                     const ImageNode *image)
+{
+   ImageCacheHeader header;
+   const unsigned long dataSize = 4UL * image->width * image->height;
+   char *cachePath;
+   char *tempPath;
+   unsigned cacheLength;
+   char ok;
+   int fd;
+
+   /* Images that would take up much of the cache are not saved. */
+   if(dataSize > MAX_IMAGE_CACHE_SIZE / 2) {
+      return;
+   }
+
+   cachePath = GetImageCachePath(fileName);
+   if(!cachePath) {
+      return;
+   }
+
+   /* Write to a temporary file and rename it into place.
+    * The file is skipped if another thread is already writing it.
+    */
+   cacheLength = strlen(cachePath);
+   tempPath = Allocate(cacheLength + 16);
+   sprintf(tempPath, "%s.%u", cachePath, (unsigned)getpid());
+   fd = open(tempPath, O_WRONLY | O_CREAT | O_EXCL, 0600);
+   if(fd >= 0) {
+
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, "JWMI", 4);
+      header.version = IMAGE_CACHE_VERSION;
+      header.headerSize = sizeof(ImageCacheHeader);
+      header.width = image->width;
+      header.height = image->height;
+      header.pathLength = strlen(fileName);
+      header.mtime = (long)sb->st_mtime;
+      header.size = (long)sb->st_size;
+
+      ok = write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header)
+         && write(fd, fileName, header.pathLength)
+            == (ssize_t)header.pathLength
+         && write(fd, image->data, dataSize) == (ssize_t)dataSize;
+      close(fd);
+      if(!ok || rename(tempPath, cachePath) != 0) {
+         unlink(tempPath);
+      }
+
+   }
+
+   Release(tempPath);
+   Release(cachePath);
+}
+
+#endif /* USE_IMAGE_CACHE */
+
 /** Load an image from the specified XPM data. */
 ImageNode *LoadImageFromData(char **data)
 {
@@ -194,21 +1097,31 @@ ImageNode *LoadImageFromDrawable(Drawable pmap, Pixmap mask)
 }
 #endif
 
+#ifdef USE_PNG
+
+/** State for reading a PNG image.
+ * The fields assigned after setjmp are volatile so that they are valid
+ * when libpng longjmps back on an error.
+ */
+typedef struct PNGReadState {
+   FILE *fd;
+   png_structp pngData;
+   png_infop pngInfo;
+   png_infop pngEndInfo;
+   ImageNode *volatile result;
+   unsigned char **volatile rows;
+} PNGReadState;
+
 /** Load a PNG image from the given file name.
- * Since libpng uses longjmp, this function is not reentrant to simplify
- * the issues surrounding longjmp and local variables.
+ * The state is kept on the stack so this can run on several decode
+ * threads at once.
  */
-#ifdef USE_PNG
 ImageNode *LoadPNGImage(const char *fileName)
 {
 
-   static ImageNode *result;
-   static FILE *fd;
-   static unsigned char **rows;
-   static png_structp pngData;
-   static png_infop pngInfo;
-   static png_infop pngEndInfo;
-
+   PNGReadState state;
+   ImageNode *result;
+   unsigned char **rows;
    unsigned char header[8];
    unsigned long rowBytes;
    int bitDepth, colorType;
@@ -218,104 +1131,105 @@ ImageNode *LoadPNGImage(const char *fileName)
 
    Assert(fileName);
 
-   result = NULL;
-   fd = NULL;
-   rows = NULL;
-   pngData = NULL;
-   pngInfo = NULL;
-   pngEndInfo = NULL;
+   state.result = NULL;
+   state.rows = NULL;
+   state.pngData = NULL;
+   state.pngInfo = NULL;
+   state.pngEndInfo = NULL;
 
-   fd = fopen(fileName, "rb");
-   if(!fd) {
+   state.fd = fopen(fileName, "rb");
+   if(!state.fd) {
       return NULL;
    }
 
-   x = fread(header, 1, sizeof(header), fd);
+   x = fread(header, 1, sizeof(header), state.fd);
    if(x != sizeof(header) || png_sig_cmp(header, 0, sizeof(header))) {
-      fclose(fd);
+      fclose(state.fd);
       return NULL;
    }
 
-   pngData = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-   if(JUNLIKELY(!pngData)) {
-      fclose(fd);
+   state.pngData = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                          NULL, NULL, NULL);
+   if(JUNLIKELY(!state.pngData)) {
+      fclose(state.fd);
       Warning(_("could not create read struct for PNG image: %s"), fileName);
       return NULL;
    }
 
-   if(JUNLIKELY(setjmp(png_jmpbuf(pngData)))) {
-      png_destroy_read_struct(&pngData, &pngInfo, &pngEndInfo);
-      if(fd) {
-         fclose(fd);
-      }
-      if(rows) {
-         ReleaseStack(rows);
-      }
-      DestroyImage(result);
-      Warning(_("error reading PNG image: %s"), fileName);
+   state.pngInfo = png_create_info_struct(state.pngData);
+   if(JUNLIKELY(!state.pngInfo)) {
+      png_destroy_read_struct(&state.pngData, NULL, NULL);
+      fclose(state.fd);
+      Warning(_("could not create info struct for PNG image: %s"), fileName);
       return NULL;
    }
 
-   pngInfo = png_create_info_struct(pngData);
-   if(JUNLIKELY(!pngInfo)) {
-      png_destroy_read_struct(&pngData, NULL, NULL);
-      fclose(fd);
-      Warning(_("could not create info struct for PNG image: %s"), fileName);
+   state.pngEndInfo = png_create_info_struct(state.pngData);
+   if(JUNLIKELY(!state.pngEndInfo)) {
+      png_destroy_read_struct(&state.pngData, &state.pngInfo, NULL);
+      fclose(state.fd);
+      Warning("could not create end info struct for PNG image: %s", fileName);
       return NULL;
    }
 
-   pngEndInfo = png_create_info_struct(pngData);
-   if(JUNLIKELY(!pngEndInfo)) {
-      png_destroy_read_struct(&pngData, &pngInfo, NULL);
-      fclose(fd);
-      Warning("could not create end info struct for PNG image: %s", fileName);
+   if(JUNLIKELY(setjmp(png_jmpbuf(state.pngData)))) {
+      png_destroy_read_struct(&state.pngData, &state.pngInfo,
+                              &state.pngEndInfo);
+      fclose(state.fd);
+      if(state.rows) {
+         ReleaseStack(state.rows);
+      }
+      DestroyImage(state.result);
+      Warning(_("error reading PNG image: %s"), fileName);
       return NULL;
    }
 
-   png_init_io(pngData, fd);
-   png_set_sig_bytes(pngData, sizeof(header));
+   png_init_io(state.pngData, state.fd);
+   png_set_sig_bytes(state.pngData, sizeof(header));
 
-   png_read_info(pngData, pngInfo);
+   png_read_info(state.pngData, state.pngInfo);
 
-   png_get_IHDR(pngData, pngInfo, &width, &height,
+   png_get_IHDR(state.pngData, state.pngInfo, &width, &height,
                 &bitDepth, &colorType, NULL, NULL, NULL);
    result = CreateImage(width, height, 0);
+   state.result = result;
 
-   png_set_expand(pngData);
+   png_set_expand(state.pngData);
 
    if(bitDepth == 16) {
-      png_set_strip_16(pngData);
+      png_set_strip_16(state.pngData);
    } else if(bitDepth < 8) {
-      png_set_packing(pngData);
+      png_set_packing(state.pngData);
    }
 
-   png_set_swap_alpha(pngData);
-   png_set_filler(pngData, 0xFF, PNG_FILLER_BEFORE);
+   png_set_swap_alpha(state.pngData);
+   png_set_filler(state.pngData, 0xFF, PNG_FILLER_BEFORE);
 
    if(colorType == PNG_COLOR_TYPE_GRAY
       || colorType == PNG_COLOR_TYPE_GRAY_ALPHA) {
-      png_set_gray_to_rgb(pngData);
+      png_set_gray_to_rgb(state.pngData);
    }
 
-   png_read_update_info(pngData, pngInfo);
+   png_read_update_info(state.pngData, state.pngInfo);
 
-   rowBytes = png_get_rowbytes(pngData, pngInfo);
+   rowBytes = png_get_rowbytes(state.pngData, state.pngInfo);
    rows = AllocateStack(result->height * sizeof(result->data));
+   state.rows = rows;
    y = 0;
    for(x = 0; x < result->height; x++) {
       rows[x] = &result->data[y];
       y += rowBytes;
    }
 
-   png_read_image(pngData, rows);
+   png_read_image(state.pngData, rows);
 
-   png_read_end(pngData, pngInfo);
-   png_destroy_read_struct(&pngData, &pngInfo, &pngEndInfo);
+   png_read_end(state.pngData, state.pngInfo);
+   png_destroy_read_struct(&state.pngData, &state.pngInfo,
+                           &state.pngEndInfo);
 
-   fclose(fd);
+   fclose(state.fd);
 
    ReleaseStack(rows);
-   rows = NULL;
 
    return result;
 
@@ -335,64 +1249,71 @@ static void JPEGErrorHandler(j_common_ptr cinfo) {
    longjmp(es->jbuffer, 1);
 }
 
+/** State for reading a JPEG image.
+ * The result is volatile since it is assigned after setjmp.
+ */
+typedef struct JPEGReadState {
+   struct jpeg_decompress_struct cinfo;
+   JPEGErrorStruct jerr;
+   FILE *fd;
+   ImageNode *volatile result;
+} JPEGReadState;
+
 ImageNode *LoadJPEGImage(const char *fileName)
 {
 
-   static ImageNode *result;
-   static struct jpeg_decompress_struct cinfo;
-   static FILE *fd;
-   static JSAMPARRAY buffer;
-   static JPEGErrorStruct jerr;
-
+   JPEGReadState state;
+   ImageNode *result;
+   JSAMPARRAY buffer;
    int rowStride;
    int x;
    int inIndex, outIndex;
 
    /* Open the file. */
-   fd = fopen(fileName, "rb");
-   if(fd == NULL) {
+   state.fd = fopen(fileName, "rb");
+   if(state.fd == NULL) {
       return NULL;
    }
 
    /* Make sure everything is initialized so we can recover from errors. */
-   result = NULL;
-   buffer = NULL;
+   state.result = NULL;
 
    /* Setup the error handler. */
-   cinfo.err = jpeg_std_error(&jerr.pub);
-   jerr.pub.error_exit = JPEGErrorHandler;
+   state.cinfo.err = jpeg_std_error(&state.jerr.pub);
+   state.jerr.pub.error_exit = JPEGErrorHandler;
 
    /* Control will return here if an error was encountered. */
-   if(setjmp(jerr.jbuffer)) {
-      DestroyImage(result);
-      jpeg_destroy_decompress(&cinfo);
-      fclose(fd);
+   if(setjmp(state.jerr.jbuffer)) {
+      DestroyImage(state.result);
+      jpeg_destroy_decompress(&state.cinfo);
+      fclose(state.fd);
       return NULL;
    }
 
    /* Prepare to load the file. */
-   jpeg_create_decompress(&cinfo);
-   jpeg_stdio_src(&cinfo, fd);
+   jpeg_create_decompress(&state.cinfo);
+   jpeg_stdio_src(&state.cinfo, state.fd);
 
    /* Check the header. */
-   jpeg_read_header(&cinfo, TRUE);
+   jpeg_read_header(&state.cinfo, TRUE);
 
    /* Start decompression. */
-   jpeg_start_decompress(&cinfo);
-   rowStride = cinfo.output_width * cinfo.output_components;
-   buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr)&cinfo,
-                                       JPOOL_IMAGE, rowStride, 1);
+   jpeg_start_decompress(&state.cinfo);
+   rowStride = state.cinfo.output_width * state.cinfo.output_components;
+   buffer = (*state.cinfo.mem->alloc_sarray)((j_common_ptr)&state.cinfo,
+                                             JPOOL_IMAGE, rowStride, 1);
 
-   result = CreateImage(cinfo.image_width, cinfo.image_height, 0);
-   result->data = Allocate(4 * result->width * result->height);
+   result = CreateImage(state.cinfo.image_width,
+                        state.cinfo.image_height, 0);
+   state.result = result;
 
    /* Read lines. */
    outIndex = 0;
-   while(cinfo.output_scanline < cinfo.output_height) {
-      jpeg_read_scanlines(&cinfo, buffer, 1);
+   while(state.cinfo.output_scanline < state.cinfo.output_height) {
+      jpeg_read_scanlines(&state.cinfo, buffer, 1);
       inIndex = 0;
       for(x = 0; x < result->width; x++) {
-         switch(cinfo.output_components) {
+         switch(state.cinfo.output_components) {
          case 1:  /* Grayscale. */
             result->data[outIndex + 1] = GETJSAMPLE(buffer[0][inIndex]);
             result->data[outIndex + 2] = GETJSAMPLE(buffer[0][inIndex]);
@@ -412,8 +1333,8 @@ ImageNode *LoadJPEGImage(const char *fileName)
    }
 
    /* Clean up. */
-   jpeg_destroy_decompress(&cinfo);
-   fclose(fd);
+   jpeg_destroy_decompress(&state.cinfo);
+   fclose(state.fd);
 
    return result;
 
@@ -612,6 +1533,272 @@ void DestroyImage(ImageNode *image) {
    }
 }
 
+/** Scale an image with a tent filter.
+ * The filter covers all source pixels when reducing the image, so large
+ * wallpapers are averaged rather than sampled. Bands of rows are scaled
+ * on the decode threads when available.
+ */
+ImageNode *ScaleImage(const ImageNode *image, int width, int height,
+                      char preserveAspect)
+{
+
+   ScaleFilter xfilter;
+   ScaleFilter yfilter;
+   ScaleBand *bands;
+   ImageNode *result;
+   unsigned int bandCount;
+   unsigned int i;
+
+   if(preserveAspect) {
+      if((long)image->width * height > (long)width * image->height) {
+         height = (int)((long)image->height * width / image->width);
+      } else {
+         width = (int)((long)image->width * height / image->height);
+      }
+   }
+   width = Max(1, width);
+   height = Max(1, height);
+
+   /* Bitmaps are drawn in black (see PutIcon). */
+   if(image->bitmap) {
+      ImageNode *expanded = ExpandBitmap(image);
+      result = ScaleImage(expanded, width, height, 0);
+      DestroyImage(expanded);
+      return result;
+   }
+
+   result = CreateImage(width, height, 0);
+   CreateScaleFilter(&xfilter, image->width, width);
+   CreateScaleFilter(&yfilter, image->height, height);
+
+   bandCount = GetScaleBandCount(height);
+   bands = Allocate(sizeof(ScaleBand) * bandCount);
+   for(i = 0; i < bandCount; i++) {
+      bands[i].source = image;
+      bands[i].dest = result;
+      bands[i].xfilter = &xfilter;
+      bands[i].yfilter = &yfilter;
+      bands[i].firstRow = (height * i) / bandCount;
+      bands[i].lastRow = (height * (i + 1)) / bandCount;
+   }
+
+#ifdef USE_IMAGE_WORKER
+   if(bandCount > 1) {
+      RunScaleJob(bands, bandCount);
+   } else {
+      ScaleImageBand(&bands[0]);
+   }
+#else
+   for(i = 0; i < bandCount; i++) {
+      ScaleImageBand(&bands[i]);
+   }
+#endif
+
+   Release(bands);
+   DestroyScaleFilter(&xfilter);
+   DestroyScaleFilter(&yfilter);
+   return result;
+
+}
+
+/** Get the number of bands to scale an image of the specified height. */
+unsigned int GetScaleBandCount(int height)
+{
+#ifdef USE_IMAGE_WORKER
+   const unsigned int count = (height + SCALE_MIN_BAND - 1) / SCALE_MIN_BAND;
+   return Max(1, Min(imageThreadCount, count));
+#else
+   return 1;
+#endif
+}
+
+/** Convert a bitmap to ARGB data. */
+ImageNode *ExpandBitmap(const ImageNode *image)
+{
+   ImageNode *result = CreateImage(image->width, image->height, 0);
+   const int count = image->width * image->height;
+   int i;
+   memset(result->data, 0, 4 * count);
+   for(i = 0; i < count; i++) {
+      if(image->data[i >> 3] & (1 << (i & 7))) {
+         result->data[4 * i] = 255;
+      }
+   }
+   return result;
+}
+
+/** Compute the filter taps for scaling from srcSize to dstSize. */
+void CreateScaleFilter(ScaleFilter *filter, int srcSize, int dstSize)
+{
+
+   const double scale = (double)dstSize / srcSize;
+   const double radius = scale < 1.0 ? 1.0 / scale : 1.0;
+   double *values;
+   int i;
+
+   filter->taps = (int)(2.0 * radius) + 2;
+   filter->index = Allocate(sizeof(int) * filter->taps * dstSize);
+   filter->weights = Allocate(sizeof(int) * filter->taps * dstSize);
+   values = Allocate(sizeof(double) * filter->taps);
+
+   for(i = 0; i < dstSize; i++) {
+      int *const index = &filter->index[i * filter->taps];
+      int *const weights = &filter->weights[i * filter->taps];
+      const double center = (i + 0.5) / scale - 0.5;
+      const double left = center - radius;
+      double total = 0.0;
+      int first = (int)left;
+      int largest = 0;
+      int sum = 0;
+      int t;
+
+      /* First tap to the right of the filter edge. */
+      if(first > left) {
+         first -= 1;
+      }
+      first += 1;
+
+      for(t = 0; t < filter->taps; t++) {
+         double distance = first + t - center;
+         if(distance < 0.0) {
+            distance = -distance;
+         }
+         values[t] = distance < radius ? 1.0 - distance / radius : 0.0;
+         total += values[t];
+         index[t] = Max(0, Min(first + t, srcSize - 1));
+      }
+      for(t = 0; t < filter->taps; t++) {
+         weights[t] = (int)(values[t] / total * (1 << SCALE_SHIFT) + 0.5);
+         sum += weights[t];
+         if(weights[t] > weights[largest]) {
+            largest = t;
+         }
+      }
+
+      /* Make sure the weights sum to one. */
+      weights[largest] += (1 << SCALE_SHIFT) - sum;
+   }
+
+   Release(values);
+
+}
+
+/** Release filter taps. */
+void DestroyScaleFilter(ScaleFilter *filter)
+{
+   Release(filter->index);
+   Release(filter->weights);
+}
+
+/** Scale a band of rows.
+ * The horizontal pass stores premultiplied 16-bit samples for the source
+ * rows under the vertical filter in a window that is reused as the band
+ * moves down; the vertical pass produces the output rows.
+ */
+void ScaleImageBand(const ScaleBand *band)
+{
+
+   const ScaleFilter *yf = band->yfilter;
+   const int width = band->dest->width;
+   unsigned short *temp;
+   int nextRow;
+   int x, y, t;
+
+   if(band->firstRow >= band->lastRow) {
+      return;
+   }
+
+   /* Source row n is kept in row (n % taps) of the window.
+    * The rows used for one output row are consecutive and there are
+    * at most taps of them, so they never share a row of the window.
+    */
+   temp = Allocate(sizeof(unsigned short) * 4 * width * yf->taps);
+   nextRow = yf->index[band->firstRow * yf->taps];
+
+   for(y = band->firstRow; y < band->lastRow; y++) {
+      const int *const index = &yf->index[y * yf->taps];
+      const int *const weights = &yf->weights[y * yf->taps];
+      unsigned char *dest = &band->dest->data[4 * y * width];
+
+      /* Horizontal pass for the rows that are new to the window. */
+      nextRow = Max(nextRow, index[0]);
+      while(nextRow <= index[yf->taps - 1]) {
+         FilterScaleRow(band, nextRow,
+                        &temp[4 * (nextRow % yf->taps) * width]);
+         nextRow += 1;
+      }
+
+      /* Vertical pass. */
+      for(x = 0; x < width; x++) {
+         unsigned long a = 0, r = 0, g = 0, b = 0;
+         for(t = 0; t < yf->taps; t++) {
+            const unsigned short *p
+               = &temp[4 * ((index[t] % yf->taps) * width + x)];
+            const unsigned long w = (unsigned long)weights[t];
+            a += w * p[0];
+            r += w * p[1];
+            g += w * p[2];
+            b += w * p[3];
+         }
+         a >>= SCALE_SHIFT;
+         dest[0] = (unsigned char)((a + 127) / 255);
+         if(a > 0) {
+            dest[1] = (unsigned char)Min(255, ((r >> SCALE_SHIFT) * 255) / a);
+            dest[2] = (unsigned char)Min(255, ((g >> SCALE_SHIFT) * 255) / a);
+            dest[3] = (unsigned char)Min(255, ((b >> SCALE_SHIFT) * 255) / a);
+         } else {
+            dest[1] = 0;
+            dest[2] = 0;
+            dest[3] = 0;
+         }
+         dest += 4;
+      }
+   }
+
+   Release(temp);
+
+}
+
+/** Apply the horizontal filter to a source row. */
+void FilterScaleRow(const ScaleBand *band, int row, unsigned short *out)
+{
+   const ScaleFilter *xf = band->xfilter;
+   const int width = band->dest->width;
+   const unsigned char *src
+      = &band->source->data[4 * row * band->source->width];
+   int x, t;
+   for(x = 0; x < width; x++) {
+      const int *const index = &xf->index[x * xf->taps];
+      const int *const weights = &xf->weights[x * xf->taps];
+      unsigned long a = 0, r = 0, g = 0, b = 0;
+      for(t = 0; t < xf->taps; t++) {
+         const unsigned char *p = &src[4 * index[t]];
+         const unsigned long wa = (unsigned long)weights[t] * p[0];
+         a += wa * 255;
+         r += wa * p[1];
+         g += wa * p[2];
+         b += wa * p[3];
+      }
+      out[4 * x + 0] = (unsigned short)(a >> SCALE_SHIFT);
+      out[4 * x + 1] = (unsigned short)(r >> SCALE_SHIFT);
+      out[4 * x + 2] = (unsigned short)(g >> SCALE_SHIFT);
+      out[4 * x + 3] = (unsigned short)(b >> SCALE_SHIFT);
+   }
+}
+
+#ifdef USE_IMAGE_WORKER
+/** Get the number of threads worth using. */
+unsigned int GetProcessorCount(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+   const long count = sysconf(_SC_NPROCESSORS_ONLN);
+   return (unsigned int)Max(1, Min(count, MAX_IMAGE_THREADS));
+#else
+   return 1;
+#endif
+}
+#endif
+
 /** Callback to allocate a color for libxpm. */
 #ifdef USE_XPM
 int AllocateColor(Display *d, Colormap cmap, char *name,
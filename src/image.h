@@ -24,12 +24,67 @@ typedef struct ImageNode {
 
 } ImageNode;
 
+/** Callback for an image decoded by RequestImage.
+ * The callback owns the image.
+ * @param image The image (NULL if the image could not be loaded).
+ * @param data The data passed to RequestImage.
+ */
+typedef void (*ImageCallback)(ImageNode *image, void *data);
+
+/*@{*/
+#define InitializeImages() (void)(0)
+void StartupImages(void);
+void ShutdownImages(void);
+#define DestroyImages()    (void)(0)
+/*@}*/
+
 /** Load an image from a file.
  * @param fileName The file containing the image.
  * @return A new image node (NULL if the image could not be loaded).
  */
 ImageNode *LoadImage(const char *fileName);
 
+/** Load an image from a file on a decode thread.
+ * The callback is run from the event loop once the image is decoded.
+ * Requests still pending at shutdown are discarded.
+ * @param fileName The file containing the image.
+ * @param callback The function to receive the image.
+ * @param data Data to pass to the callback.
+ * @return 1 if queued, 0 if the image must be loaded with LoadImage.
+ */
+char RequestImage(const char *fileName, ImageCallback callback, void *data);
+
+/** Load an image from a file and scale it on a decode thread.
+ * @param fileName The file containing the image.
+ * @param width The width to scale to.
+ * @param height The height to scale to.
+ * @param preserveAspect Set to fit within width and height.
+ * @param callback The function to receive the image.
+ * @param data Data to pass to the callback.
+ * @return 1 if queued, 0 if the image must be loaded with LoadImage.
+ */
+char RequestScaledImage(const char *fileName,
+                        int width, int height, char preserveAspect,
+                        ImageCallback callback, void *data);
+
+/** Wait for the requests for a file made with the specified callback.
+ * Requests that have not started are decoded on the calling thread.
+ * The callback is run for each of them before returning; other
+ * requests are left for ProcessImageEvents.
+ * @param fileName The file name passed to RequestImage.
+ * @param callback The callback passed to RequestImage.
+ */
+void WaitForImage(const char *fileName, ImageCallback callback);
+
+/** Get the file descriptor that becomes readable when decoded images
+ * are ready.
+ * @return The file descriptor (-1 if images are decoded synchronously).
+ */
+int GetImageEventFd(void);
+
+/** Run callbacks for decoded images. */
+void ProcessImageEvents(void);
+
 /** Load an image from data.
  * The data must be in the format from the EWMH spec.
  * @param data The image data.
@@ -52,6 +107,16 @@ ImageNode *LoadImageFromDrawable(Drawable pmap, Pixmap mask);
  */
 ImageNode *CreateImage(unsigned int width, unsigned int height, char bitmap);
 
+/** Create a scaled copy of an image.
+ * @param image The image to scale.
+ * @param width The width of the new image.
+ * @param height The height of the new image.
+ * @param preserveAspect Set to fit within width and height.
+ * @return A new image node.
+ */
+ImageNode *ScaleImage(const ImageNode *image, int width, int height,
+                      char preserveAspect);
+
 /** Destroy an image node.
  * @param image The image to destroy.
  */
@@ -19,6 +19,7 @@
 #  include <string.h>
 #  include <ctype.h>
 #  include <limits.h>
+#  include <regex.h>
 
    /* Ideally png.h would be included in image.c, which is the only
     * file that references it. Unfortunately, if setjmp.h is included
@@ -59,6 +60,21 @@
 #  ifdef HAVE_SYS_SELECT_H
 #     include <sys/select.h>
 #  endif
+#  ifdef HAVE_SYS_STAT_H
+#     include <sys/stat.h>
+#  endif
+#  ifdef HAVE_SYS_MMAN_H
+#     include <sys/mman.h>
+#  endif
+#  ifdef HAVE_FCNTL_H
+#     include <fcntl.h>
+#  endif
+#  ifdef HAVE_DIRENT_H
+#     include <dirent.h>
+#  endif
+#  ifdef HAVE_SYS_INOTIFY_H
+#     include <sys/inotify.h>
+#  endif
 
 #  include <X11/Xlib.h>
 #  ifdef HAVE_X11_XUTIL_H
@@ -84,6 +100,12 @@
 #     include <X11/extensions/shape.h>
 #  endif
 
+#  ifdef USE_SHM
+#     include <sys/ipc.h>
+#     include <sys/shm.h>
+#     include <X11/extensions/XShm.h>
+#  endif
+
 #  ifdef USE_XMU
 #     include <X11/Xmu/Xmu.h>
 #  endif
@@ -317,6 +317,9 @@
 #define JXSetClipRectangles( a, b, c, d, e, f, g ) \
    ( SetCheckpoint(), XSetClipRectangles( a, b, c, d, e, f, g ) )
 
+#define JXSetGraphicsExposures( a, b, c ) \
+   ( SetCheckpoint(), XSetGraphicsExposures( a, b, c ) )
+
 #define JXSetErrorHandler( a ) \
    ( SetCheckpoint(), XSetErrorHandler( a ) )
 
@@ -326,6 +329,12 @@
 #define JXSetForeground( a, b, c ) \
    ( SetCheckpoint(), XSetForeground( a, b, c ) )
 
+#define JXSetTile( a, b, c ) \
+   ( SetCheckpoint(), XSetTile( a, b, c ) )
+
+#define JXSetTSOrigin( a, b, c, d ) \
+   ( SetCheckpoint(), XSetTSOrigin( a, b, c, d ) )
+
 #define JXGetInputFocus( a, b, c ) \
    ( SetCheckpoint(), XGetInputFocus( a, b, c ) )
 
@@ -366,6 +375,21 @@
 #define JXShapeSelectInput( a, b, c ) \
    ( SetCheckpoint(), XShapeSelectInput( a, b, c ) )
 
+#define JXShmQueryExtension( a ) \
+   ( SetCheckpoint(), XShmQueryExtension( a ) )
+
+#define JXShmCreateImage( a, b, c, d, e, f, g, h ) \
+   ( SetCheckpoint(), XShmCreateImage( a, b, c, d, e, f, g, h ) )
+
+#define JXShmAttach( a, b ) \
+   ( SetCheckpoint(), XShmAttach( a, b ) )
+
+#define JXShmDetach( a, b ) \
+   ( SetCheckpoint(), XShmDetach( a, b ) )
+
+#define JXShmPutImage( a, b, c, d, e, f, g, h, i, j, k ) \
+   ( SetCheckpoint(), XShmPutImage( a, b, c, d, e, f, g, h, i, j, k ) )
+
 #define JXStoreName( a, b, c ) \
    ( SetCheckpoint(), XStoreName( a, b, c ) )
 
@@ -470,5 +494,11 @@
    ( SetCheckpoint(), \
      XRenderComposite( a, b, c, d, e, f, g, h, i, j, k, l, m) )
 
+#define JXRenderCreateSolidFill( a, b ) \
+   ( SetCheckpoint(), XRenderCreateSolidFill( a, b ) )
+
+#define JXRenderFillRectangles( a, b, c, d, e, f ) \
+   ( SetCheckpoint(), XRenderFillRectangles( a, b, c, d, e, f ) )
+
 #endif /* JXLIB_H */
 
@@ -32,6 +32,7 @@
 #include "swallow.h"
 #include "screen.h"
 #include "root.h"
+#include "winmenu.h"
 #include "desktop.h"
 #include "place.h"
 #include "clock.h"
@@ -41,6 +42,9 @@
 #include "settings.h"
 #include "timing.h"
 #include "grab.h"
+#include "gradient.h"
+#include "image.h"
+#include "shm.h"
 
 Display *display = NULL;
 Window rootWindow;
@@ -74,6 +78,9 @@ int shapeEvent;
 #ifdef USE_XRENDER
 char haveRender;
 #endif
+#ifdef USE_SHM
+char haveShm;
+#endif
 
 static const char CONFIG_FILE[] = "/.jwmrc";
 
@@ -93,6 +100,9 @@ static void DoExit(int code);
 static void SendRestart(void);
 static void SendExit(void);
 static void SendReload(void);
+#ifdef USE_SHM
+static char IsLocalDisplay(void);
+#endif
 static void SendJWMMessage(const char *message);
 
 static char *displayString = NULL;
@@ -432,6 +442,15 @@ void StartupConnection(void)
    }
 #endif
 
+#ifdef USE_SHM
+   haveShm = IsLocalDisplay() && JXShmQueryExtension(display);
+   if(haveShm) {
+      Debug("shm extension enabled");
+   } else {
+      Debug("shm extension disabled");
+   }
+#endif
+
    /* Make sure we have input focus. */
    win = None;
    JXGetInputFocus(display, &win, &revert);
@@ -450,6 +469,17 @@ void CloseConnection(void)
    JXCloseDisplay(display);
 }
 
+#ifdef USE_SHM
+/** Determine if the X server is on this machine.
+ * Shared memory segments can only be attached by a local server.
+ */
+char IsLocalDisplay(void)
+{
+   const char *name = DisplayString(display);
+   return name[0] == ':' || !strncmp(name, "unix:", 5);
+}
+#endif
+
 /** Close the X server connection. */
 void ShutdownConnection(void)
 {
@@ -481,6 +511,9 @@ void Initialize(void)
 #endif
    InitializeDock();
    InitializeFonts();
+   InitializeGradients();
+   InitializeImages();
+   InitializeShm();
    InitializeGroups();
    InitializeHints();
    InitializeIcons();
@@ -489,6 +522,7 @@ void Initialize(void)
    InitializePlacement();
    InitializePopup();
    InitializeRootMenu();
+   InitializeWindowMenu();
    InitializeScreens();
    InitializeSettings();
    InitializeSwallow();
@@ -514,6 +548,9 @@ void Startup(void)
 
    StartupGroups();
    StartupColors();
+   StartupGradients();
+   StartupImages();
+   StartupShm();
    StartupIcons();
    StartupBackgrounds();
    StartupFonts();
@@ -538,6 +575,7 @@ void Startup(void)
    StartupPopup();
 
    StartupRootMenu();
+   StartupWindowMenu();
 
    SetDefaultCursor(rootWindow);
    ReadCurrentDesktop();
@@ -581,6 +619,7 @@ void Shutdown(void)
    ShutdownKeys();
    ShutdownPager();
    ShutdownRootMenu();
+   ShutdownWindowMenu();
    ShutdownDock();
    ShutdownTray();
    ShutdownTrayButtons();
@@ -588,8 +627,11 @@ void Shutdown(void)
    ShutdownClock();
    ShutdownBorders();
    ShutdownClients();
+   ShutdownImages();
    ShutdownBackgrounds();
+   ShutdownGradients();
    ShutdownIcons();
+   ShutdownShm();
    ShutdownCursors();
    ShutdownFonts();
    ShutdownColors();
@@ -624,6 +666,9 @@ void Destroy(void)
 #endif
    DestroyDock();
    DestroyFonts();
+   DestroyGradients();
+   DestroyImages();
+   DestroyShm();
    DestroyGroups();
    DestroyHints();
    DestroyIcons();
@@ -632,6 +677,7 @@ void Destroy(void)
    DestroyPlacement();
    DestroyPopup();
    DestroyRootMenu();
+   DestroyWindowMenu();
    DestroyScreens();
    DestroySettings();
    DestroySwallow();
@@ -42,6 +42,9 @@ extern int shapeEvent;
 #ifdef USE_XRENDER
 extern char haveRender;
 #endif
+#ifdef USE_SHM
+extern char haveShm;
+#endif
 
 extern char *configPath;
 
@@ -9,32 +9,399 @@
 
 #include "jwm.h"
 #include "match.h"
+#include "misc.h"
 
-#include <regex.h>
+/* Must be a power of two. */
+#define HASH_SIZE 64
 
-/** Determine if expression matches pattern. */
-char Match(const char *pattern, const char *expression)
-{
+/** Kinds of patterns. */
+typedef unsigned char PatternKind;
+#define PATTERN_EXACT      0  /**< "^literal$" */
+#define PATTERN_PREFIX     1  /**< "^literal" */
+#define PATTERN_SUFFIX     2  /**< "literal$" */
+#define PATTERN_SUBSTRING  3  /**< "literal" */
+#define PATTERN_REGEX      4  /**< Anything else. */
+
+/** List of pattern identifiers. */
+typedef struct PatternIdType {
+   unsigned int id;
+   struct PatternIdType *next;
+} PatternIdType;
+
+/** Node in a prefix or suffix trie. */
+typedef struct TrieNode {
+   struct TrieNode *children;
+   struct TrieNode *next;        /**< Next sibling. */
+   PatternIdType *ids;           /**< Patterns ending at this node. */
+   char ch;
+} TrieNode;
 
+/** A literal string and the patterns using it. */
+typedef struct LiteralNode {
+   char *str;
+   PatternIdType *ids;
+   struct LiteralNode *next;
+} LiteralNode;
+
+/** A pattern that must be evaluated as a regular expression. */
+typedef struct RegexNode {
    regex_t re;
-   regmatch_t rm;
-   int rc;
+   unsigned int id;
+   struct RegexNode *next;
+} RegexNode;
+
+/** Set of indexed patterns. */
+typedef struct PatternSetType {
+   LiteralNode *exact[HASH_SIZE];   /**< Hash of "^literal$" patterns. */
+   TrieNode prefixes;               /**< Trie of "^literal" patterns. */
+   TrieNode suffixes;               /**< Reversed trie of "literal$". */
+   LiteralNode *substrings;         /**< Unanchored literals. */
+   RegexNode *regexes;              /**< Everything else. */
+} PatternSetType;
+
+static PatternKind ParsePattern(const char *pattern, char **literal);
+static char IsSpecial(char ch);
+static void AddPatternId(PatternIdType **ip, unsigned int id);
+static void MarkPatternIds(const PatternIdType *ip, char *matches);
+static void ReleasePatternIds(PatternIdType *ip);
+static const TrieNode *FindTrieChild(const TrieNode *np, char ch);
+static TrieNode *GetTrieChild(TrieNode *np, char ch);
+static void ReleaseTrie(TrieNode *np);
+static void ReleaseLiterals(LiteralNode *lp);
+
+/** Create an empty pattern set. */
+PatternSetType *CreatePatternSet(void)
+{
+   PatternSetType *sp = Allocate(sizeof(PatternSetType));
+   memset(sp, 0, sizeof(PatternSetType));
+   return sp;
+}
+
+/** Add a pattern to a pattern set. */
+char AddPatternToSet(PatternSetType *sp, const char *pattern,
+                     unsigned int id)
+{
+   LiteralNode *lp;
+   RegexNode *rp;
+   TrieNode *np;
+   char *literal;
+   unsigned int index;
+   int len;
+   int x;
+
+   Assert(sp);
+   Assert(pattern);
 
-   if(!pattern && !expression) {
+   switch(ParsePattern(pattern, &literal)) {
+   case PATTERN_EXACT:
+      index = GetStringHash(literal) & (HASH_SIZE - 1);
+      for(lp = sp->exact[index]; lp; lp = lp->next) {
+         if(!strcmp(lp->str, literal)) {
+            break;
+         }
+      }
+      if(lp) {
+         Release(literal);
+      } else {
+         lp = Allocate(sizeof(LiteralNode));
+         lp->str = literal;
+         lp->ids = NULL;
+         lp->next = sp->exact[index];
+         sp->exact[index] = lp;
+      }
+      AddPatternId(&lp->ids, id);
+      return 1;
+   case PATTERN_PREFIX:
+      np = &sp->prefixes;
+      for(x = 0; literal[x]; x++) {
+         np = GetTrieChild(np, literal[x]);
+      }
+      AddPatternId(&np->ids, id);
+      Release(literal);
+      return 1;
+   case PATTERN_SUFFIX:
+      np = &sp->suffixes;
+      len = strlen(literal);
+      for(x = len - 1; x >= 0; x--) {
+         np = GetTrieChild(np, literal[x]);
+      }
+      AddPatternId(&np->ids, id);
+      Release(literal);
+      return 1;
+   case PATTERN_SUBSTRING:
+      lp = Allocate(sizeof(LiteralNode));
+      lp->str = literal;
+      lp->ids = NULL;
+      AddPatternId(&lp->ids, id);
+      lp->next = sp->substrings;
+      sp->substrings = lp;
+      return 1;
+   default:
+      rp = Allocate(sizeof(RegexNode));
+      if(regcomp(&rp->re, pattern, REG_EXTENDED | REG_NOSUB) != 0) {
+         Release(rp);
+         return 0;
+      }
+      rp->id = id;
+      rp->next = sp->regexes;
+      sp->regexes = rp;
       return 1;
-   } else if(!pattern || !expression) {
-      return 0;
    }
+}
+
+/** Find all patterns in a set that match an expression. */
+void MatchPatternSet(const PatternSetType *sp, const char *expression,
+                     char *matches)
+{
+   const LiteralNode *lp;
+   const RegexNode *rp;
+   const TrieNode *np;
+   unsigned int index;
+   int len;
+   int x;
 
-   if(regcomp(&re, pattern, REG_EXTENDED) != 0) {
+   Assert(sp);
+   Assert(matches);
+
+   if(!expression) {
+      return;
+   }
+
+   /* Exact matches. */
+   index = GetStringHash(expression) & (HASH_SIZE - 1);
+   for(lp = sp->exact[index]; lp; lp = lp->next) {
+      if(!strcmp(lp->str, expression)) {
+         MarkPatternIds(lp->ids, matches);
+         break;
+      }
+   }
+
+   /* Prefixes: every node along the path is a match. */
+   np = &sp->prefixes;
+   MarkPatternIds(np->ids, matches);
+   for(x = 0; expression[x]; x++) {
+      np = FindTrieChild(np, expression[x]);
+      if(!np) {
+         break;
+      }
+      MarkPatternIds(np->ids, matches);
+   }
+
+   /* Suffixes: the same, walking the expression backwards. */
+   np = &sp->suffixes;
+   MarkPatternIds(np->ids, matches);
+   len = strlen(expression);
+   for(x = len - 1; x >= 0; x--) {
+      np = FindTrieChild(np, expression[x]);
+      if(!np) {
+         break;
+      }
+      MarkPatternIds(np->ids, matches);
+   }
+
+   /* Unanchored literals and irregular patterns are checked one by one. */
+   for(lp = sp->substrings; lp; lp = lp->next) {
+      if(strstr(expression, lp->str)) {
+         MarkPatternIds(lp->ids, matches);
+      }
+   }
+   for(rp = sp->regexes; rp; rp = rp->next) {
+      if(regexec(&rp->re, expression, 0, NULL, 0) == 0) {
+         matches[rp->id] = 1;
+      }
+   }
+
+}
+
+/** Destroy a pattern set. */
+void DestroyPatternSet(PatternSetType *sp)
+{
+   RegexNode *rp;
+   unsigned int x;
+
+   if(!sp) {
+      return;
+   }
+   for(x = 0; x < HASH_SIZE; x++) {
+      ReleaseLiterals(sp->exact[x]);
+   }
+   ReleaseTrie(sp->prefixes.children);
+   ReleasePatternIds(sp->prefixes.ids);
+   ReleaseTrie(sp->suffixes.children);
+   ReleasePatternIds(sp->suffixes.ids);
+   ReleaseLiterals(sp->substrings);
+   while(sp->regexes) {
+      rp = sp->regexes->next;
+      regfree(&sp->regexes->re);
+      Release(sp->regexes);
+      sp->regexes = rp;
+   }
+   Release(sp);
+}
+
+/** Determine the kind of a pattern.
+ * For all kinds except PATTERN_REGEX, literal is set to a newly
+ * allocated string containing the text to match.
+ */
+PatternKind ParsePattern(const char *pattern, char **literal)
+{
+   const char *str = pattern;
+   char *result;
+   char anchorStart = 0;
+   char anchorEnd = 0;
+   int len = 0;
+
+   /* "^.*" is the same as no anchor. */
+   if(str[0] == '^') {
+      anchorStart = 1;
+      str += 1;
+   }
+   if(str[0] == '.' && str[1] == '*') {
+      anchorStart = 0;
+      str += 2;
+   }
+
+   result = Allocate(strlen(str) + 1);
+   while(*str) {
+      if(str[0] == '$' && str[1] == 0) {
+         anchorEnd = 1;
+         break;
+      } else if(str[0] == '.' && str[1] == '*'
+                && (str[2] == 0 || (str[2] == '$' && str[3] == 0))) {
+         /* ".*" and ".*$" at the end are the same as no anchor. */
+         break;
+      } else if(str[0] == '\\' && IsSpecial(str[1])) {
+         result[len++] = str[1];
+         str += 2;
+      } else if(IsSpecial(str[0])) {
+         Release(result);
+         *literal = NULL;
+         return PATTERN_REGEX;
+      } else {
+         result[len++] = str[0];
+         str += 1;
+      }
+   }
+   result[len] = 0;
+   *literal = result;
+
+   if(anchorStart && anchorEnd) {
+      return PATTERN_EXACT;
+   } else if(anchorStart) {
+      return PATTERN_PREFIX;
+   } else if(anchorEnd) {
+      return PATTERN_SUFFIX;
+   } else {
+      return PATTERN_SUBSTRING;
+   }
+}
+
+/** Determine if a character has a special meaning in a pattern. */
+char IsSpecial(char ch)
+{
+   switch(ch) {
+   case '^':
+   case '$':
+   case '.':
+   case '[':
+   case ']':
+   case '(':
+   case ')':
+   case '{':
+   case '}':
+   case '|':
+   case '*':
+   case '+':
+   case '?':
+   case '\\':
+      return 1;
+   default:
       return 0;
    }
+}
+
+/** Add a pattern identifier to a list. */
+void AddPatternId(PatternIdType **ip, unsigned int id)
+{
+   PatternIdType *np = Allocate(sizeof(PatternIdType));
+   np->id = id;
+   np->next = *ip;
+   *ip = np;
+}
+
+/** Mark all patterns in a list as matching. */
+void MarkPatternIds(const PatternIdType *ip, char *matches)
+{
+   while(ip) {
+      matches[ip->id] = 1;
+      ip = ip->next;
+   }
+}
 
-   rc = regexec(&re, expression, 0, &rm, 0);
+/** Release a list of pattern identifiers. */
+void ReleasePatternIds(PatternIdType *ip)
+{
+   PatternIdType *np;
+   while(ip) {
+      np = ip->next;
+      Release(ip);
+      ip = np;
+   }
+}
 
-   regfree(&re);
+/** Find the child of a trie node for a character. */
+const TrieNode *FindTrieChild(const TrieNode *np, char ch)
+{
+   const TrieNode *cp;
+   for(cp = np->children; cp; cp = cp->next) {
+      if(cp->ch == ch) {
+         return cp;
+      }
+   }
+   return NULL;
+}
 
-   return rc == 0 ? 1 : 0;
+/** Get the child of a trie node for a character, creating it if needed. */
+TrieNode *GetTrieChild(TrieNode *np, char ch)
+{
+   TrieNode *cp;
+   for(cp = np->children; cp; cp = cp->next) {
+      if(cp->ch == ch) {
+         return cp;
+      }
+   }
+   cp = Allocate(sizeof(TrieNode));
+   cp->children = NULL;
+   cp->ids = NULL;
+   cp->ch = ch;
+   cp->next = np->children;
+   np->children = cp;
+   return cp;
+}
 
+/** Release a list of trie nodes and their children. */
+void ReleaseTrie(TrieNode *np)
+{
+   TrieNode *next;
+   while(np) {
+      next = np->next;
+      ReleaseTrie(np->children);
+      ReleasePatternIds(np->ids);
+      Release(np);
+      np = next;
+   }
+}
+
+/** Release a list of literal nodes. */
+void ReleaseLiterals(LiteralNode *lp)
+{
+   LiteralNode *next;
+   while(lp) {
+      next = lp->next;
+      ReleasePatternIds(lp->ids);
+      Release(lp->str);
+      Release(lp);
+      lp = next;
+   }
 }
 
@@ -10,12 +10,38 @@
 #ifndef MATCH_H
 #define MATCH_H
 
-/** Check if an expression matches a pattern.
- * @param pattern The pattern to match against.
- * @param expression The expression to check.
- * @return 1 if there is a match, 0 otherwise.
+struct PatternSetType;
+
+/** Create an empty pattern set.
+ * A pattern set indexes many patterns so that an expression can be
+ * tested against all of them at once. Literal patterns (optionally
+ * anchored with '^' and '$') are matched without using regex.
+ * @return The pattern set.
+ */
+struct PatternSetType *CreatePatternSet(void);
+
+/** Add a pattern to a pattern set.
+ * @param sp The pattern set.
+ * @param pattern The pattern to add.
+ * @param id The identifier to report when the pattern matches.
+ * @return 1 on success, 0 if the pattern is not a valid expression.
+ */
+char AddPatternToSet(struct PatternSetType *sp, const char *pattern,
+                     unsigned int id);
+
+/** Find all patterns in a set that match an expression.
+ * @param sp The pattern set.
+ * @param expression The expression to check (may be NULL).
+ * @param matches Array indexed by pattern identifier. Entries for
+ *                matching patterns are set to 1; others are unchanged.
+ */
+void MatchPatternSet(const struct PatternSetType *sp,
+                     const char *expression, char *matches);
+
+/** Destroy a pattern set.
+ * @param sp The pattern set.
  */
-char Match(const char *pattern, const char *expression);
+void DestroyPatternSet(struct PatternSetType *sp);
 
 #endif /* MATCH_H */
 
@@ -26,6 +26,7 @@
 
 #define BASE_ICON_OFFSET   3
 #define MENU_BORDER_SIZE   1
+#define SEPARATOR_HEIGHT   6
 
 typedef unsigned char MenuSelectionType;
 #define MENU_NOSELECTION   0
@@ -41,6 +42,7 @@ static void UnpatchMenu(Menu *menu);
 static void CreateMenu(Menu *menu, int x, int y, char keyboard);
 static void HideMenu(Menu *menu);
 static void DrawMenu(Menu *menu);
+static void ClearMenuSelection(Menu *menu);
 
 static char MenuLoop(Menu *menu, RunMenuCommandType runner);
 static MenuSelectionType UpdateMotion(Menu *menu,
@@ -49,6 +51,7 @@ static MenuSelectionType UpdateMotion(Menu *menu,
 
 static void UpdateMenu(Menu *menu);
 static void DrawMenuItem(Menu *menu, MenuItem *item, int index);
+static void RefreshMenuItem(Menu *menu, int index);
 static MenuItem *GetMenuItem(Menu *menu, int index);
 static int GetNextMenuIndex(Menu *menu);
 static int GetPreviousMenuIndex(Menu *menu);
@@ -77,6 +80,9 @@ void InitializeMenu(Menu *menu)
    int hasSubmenu;
    char hasIcon;
 
+   menu->window = None;
+   menu->pixmap = None;
+   menu->drawn = 0;
    menu->textOffset = 0;
    menu->itemCount = 0;
 
@@ -136,7 +142,7 @@ void InitializeMenu(Menu *menu)
    for(np = menu->items; np; np = np->next) {
       menu->offsets[index++] = menu->height;
       if(np->type == MENU_ITEM_SEPARATOR) {
-         menu->height += 6;
+         menu->height += SEPARATOR_HEIGHT;
       } else {
          menu->height += menu->itemHeight;
       }
@@ -210,11 +216,35 @@ void HideMenu(Menu *menu)
    }
 }
 
+/** Release the window and pixmap of a menu. */
+void ReleaseMenuWindows(Menu *menu)
+{
+   MenuItem *np;
+   if(menu->window != None) {
+      JXDestroyWindow(display, menu->window);
+      ReleaseTextDrawable(menu->pixmap);
+      JXFreePixmap(display, menu->pixmap);
+      menu->window = None;
+      menu->pixmap = None;
+      menu->drawn = 0;
+   }
+   for(np = menu->items; np; np = np->next) {
+      if(np->submenu) {
+         ReleaseMenuWindows(np->submenu);
+      }
+   }
+}
+
 /** Destroy a menu. */
 void DestroyMenu(Menu *menu)
 {
    MenuItem *np;
    if(menu) {
+      if(menu->window != None) {
+         JXDestroyWindow(display, menu->window);
+         ReleaseTextDrawable(menu->pixmap);
+         JXFreePixmap(display, menu->pixmap);
+      }
       while(menu->items) {
          np = menu->items->next;
          if(menu->items->name) {
@@ -266,8 +296,9 @@ char ShowSubmenu(Menu *menu, Menu *parent,
    status = MenuLoop(menu, runner);
    menuShown -= 1;
 
-   JXDestroyWindow(display, menu->window);
-   JXFreePixmap(display, menu->pixmap);
+   /* Keep the window and pixmap for the next time this menu is shown. */
+   JXUnmapWindow(display, menu->window);
+   ClearMenuSelection(menu);
 
    return status;
 
@@ -449,37 +480,48 @@ void CreateMenu(Menu *menu, int x, int y, char keyboard)
    menu->y = y;
    menu->parentOffset = temp - y;
 
-   attrMask = 0;
+   if(menu->window != None) {
+      JXMoveWindow(display, menu->window, x, y);
+      JXMapRaised(display, menu->window);
+   } else {
 
-   attrMask |= CWEventMask;
-   attr.event_mask = ExposureMask;
+      attrMask = 0;
 
-   attrMask |= CWBackPixel;
-   attr.background_pixel = colors[COLOR_MENU_BG];
+      attrMask |= CWEventMask;
+      attr.event_mask = ExposureMask;
 
-   attrMask |= CWSaveUnder;
-   attr.save_under = True;
+      attrMask |= CWBackPixel;
+      attr.background_pixel = colors[COLOR_MENU_BG];
 
-   menu->window = JXCreateWindow(display, rootWindow, x, y,
-                                 menu->width, menu->height, 0,
-                                 CopyFromParent, InputOutput,
-                                 CopyFromParent, attrMask, &attr);
-   SetAtomAtom(menu->window, ATOM_NET_WM_WINDOW_TYPE,
-               ATOM_NET_WM_WINDOW_TYPE_MENU);
-   menu->pixmap = JXCreatePixmap(display, menu->window,
-                                 menu->width, menu->height, rootDepth);
+      attrMask |= CWSaveUnder;
+      attr.save_under = True;
 
-   if(settings.menuOpacity < UINT_MAX) {
-      SetCardinalAtom(menu->window, ATOM_NET_WM_WINDOW_OPACITY,
-                      settings.menuOpacity);
-   }
+      menu->window = JXCreateWindow(display, rootWindow, x, y,
+                                    menu->width, menu->height, 0,
+                                    CopyFromParent, InputOutput,
+                                    CopyFromParent, attrMask, &attr);
+      SetAtomAtom(menu->window, ATOM_NET_WM_WINDOW_TYPE,
+                  ATOM_NET_WM_WINDOW_TYPE_MENU);
+      menu->pixmap = JXCreatePixmap(display, menu->window,
+                                    menu->width, menu->height, rootDepth);
+      menu->drawn = 0;
 
-   JXMapRaised(display, menu->window); 
+      if(settings.menuOpacity < UINT_MAX) {
+         SetCardinalAtom(menu->window, ATOM_NET_WM_WINDOW_OPACITY,
+                         settings.menuOpacity);
+      }
+
+      JXMapRaised(display, menu->window);
+
+   }
 
    if(keyboard && menu->itemCount != 0) {
       const int y = menu->offsets[0] + menu->itemHeight / 2;
       menu->lastIndex = 0;
       menu->currentIndex = 0;
+      if(menu->drawn) {
+         DrawMenuItem(menu, GetMenuItem(menu, 0), 0);
+      }
       MoveMouse(menu->window, menu->itemHeight / 2, y);
    } else {
       menu->lastIndex = -1;
@@ -488,13 +530,23 @@ void CreateMenu(Menu *menu, int x, int y, char keyboard)
 
 }
 
-/** Draw a menu. */
+/** Draw a menu.
+ * The pixmap is only rendered the first time; afterwards the items
+ * that change are drawn as the selection moves.
+ */
 void DrawMenu(Menu *menu)
 {
 
    MenuItem *np;
    int x;
 
+   if(menu->drawn) {
+      JXCopyArea(display, menu->pixmap, menu->window, rootGC,
+                 0, 0, menu->width, menu->height, 0, 0);
+      return;
+   }
+   menu->drawn = 1;
+
    JXSetForeground(display, rootGC, colors[COLOR_MENU_BG]);
    JXFillRectangle(display, menu->pixmap, rootGC, 0, 0,
                    menu->width, menu->height);
@@ -531,6 +583,17 @@ void DrawMenu(Menu *menu)
 
 }
 
+/** Remove the highlight from a hidden menu so it is cached unselected. */
+void ClearMenuSelection(Menu *menu)
+{
+   const int index = menu->currentIndex;
+   menu->lastIndex = -1;
+   menu->currentIndex = -1;
+   if(menu->drawn && index >= 0) {
+      DrawMenuItem(menu, GetMenuItem(menu, index), index);
+   }
+}
+
 /** Determine the action to take given an event. */
 MenuSelectionType UpdateMotion(Menu *menu,
                                RunMenuCommandType runner,
@@ -704,25 +767,34 @@ MenuSelectionType UpdateMotion(Menu *menu,
 
 }
 
-/** Update the menu selection. */
+/** Update the menu selection.
+ * Only the old and new selections are redrawn and copied.
+ */
 void UpdateMenu(Menu *menu)
 {
 
-   MenuItem *ip;
-
    /* Clear the old selection. */
-   ip = GetMenuItem(menu, menu->lastIndex);
-   DrawMenuItem(menu, ip, menu->lastIndex);
+   if(menu->lastIndex != menu->currentIndex) {
+      RefreshMenuItem(menu, menu->lastIndex);
+   }
 
    /* Highlight the new selection. */
-   ip = GetMenuItem(menu, menu->currentIndex);
-   if(ip != NULL) {
-      DrawMenuItem(menu, ip, menu->currentIndex);
-   }
+   RefreshMenuItem(menu, menu->currentIndex);
 
-   JXCopyArea(display, menu->pixmap, menu->window, rootGC,
-              0, 0, menu->width, menu->height, 0, 0);
+}
 
+/** Redraw a menu item and copy it to the menu window. */
+void RefreshMenuItem(Menu *menu, int index)
+{
+   MenuItem *ip = GetMenuItem(menu, index);
+   if(ip) {
+      const int y = menu->offsets[index];
+      const int height = ip->type == MENU_ITEM_SEPARATOR
+                       ? SEPARATOR_HEIGHT : menu->itemHeight;
+      DrawMenuItem(menu, ip, index);
+      JXCopyArea(display, menu->pixmap, menu->window, rootGC,
+                 0, y, menu->width, height, 0, y);
+   }
 }
 
 /** Draw a menu item. */
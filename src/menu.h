@@ -85,6 +85,7 @@ typedef struct Menu {
    /* These fields are handled by menu.c */
    Window window;          /**< The menu window. */
    Pixmap pixmap;          /**< Pixmap where the menu is rendered. */
+   char drawn;             /**< Set once the pixmap has been rendered. */
    int x;                  /**< The x-coordinate of the menu. */
    int y;                  /**< The y-coordinate of the menu. */
    int width;              /**< The width of the menu. */
@@ -120,6 +121,12 @@ void InitializeMenu(Menu *menu);
 void ShowMenu(Menu *menu, RunMenuCommandType runner,
               int x, int y, char keyboard);
 
+/** Release the window and pixmap of a menu and its static submenus.
+ * Windows are otherwise kept between openings.
+ * @param menu The menu.
+ */
+void ReleaseMenuWindows(Menu *menu);
+
 /** Destroy a menu structure.
  * @param menu The menu to destroy.
  */
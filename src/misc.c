@@ -281,3 +281,16 @@ int StrCmpNoCase(const char *a, const char *b)
    }
    return *b - *a;
 }
+
+/** Get a hash value for a string. */
+unsigned int GetStringHash(const char *str)
+{
+   unsigned int hash = 0;
+   if(str) {
+      unsigned int x;
+      for(x = 0; str[x]; x++) {
+         hash = (hash + (hash << 5)) ^ (unsigned int)str[x];
+      }
+   }
+   return hash;
+}
@@ -78,4 +78,11 @@ const char *FindKey(const StringMappingType *mapping, int count, int value);
 /** Case insensitive string compare. */
 int StrCmpNoCase(const char *a, const char *b);
 
+/** Get a hash value for a string.
+ * Note that NULL is accepted and hashes to 0.
+ * @param str The string to hash.
+ * @return The (unreduced) hash value.
+ */
+unsigned int GetStringHash(const char *str);
+
 #endif /* MISC_H */
@@ -78,6 +78,7 @@ void ShutdownPager(void)
 {
    PagerType *pp;
    for(pp = pagers; pp; pp = pp->next) {
+      ReleaseTextDrawable(pp->buffer);
       JXFreePixmap(display, pp->buffer);
    }
 }
@@ -178,6 +179,7 @@ void SetSize(TrayComponentType *cp, int width, int height)
    }
 
    if(pp->buffer != None) {
+      ReleaseTextDrawable(pp->buffer);
       JXFreePixmap(display, pp->buffer);
       pp->buffer = JXCreatePixmap(display, rootWindow, cp->width,
                                   cp->height, rootDepth);
@@ -485,6 +485,7 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
 
    Assert(menu);
 
+   menu->window = None;
    menu->offsets = NULL;
    while(start) {
       switch(start->type) {
@@ -500,6 +501,7 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
 
          value = FindAttribute(start->attributes, ICON_ATTRIBUTE);
          last->iconName = CopyString(value);
+         PreloadIcon(value);
 
          last->action.type = MA_DYNAMIC;
          last->action.str = CopyString(start->value);
@@ -525,6 +527,7 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
 
          value = FindAttribute(start->attributes, ICON_ATTRIBUTE);
          last->iconName = CopyString(value);
+         PreloadIcon(value);
 
          last->submenu = Allocate(sizeof(Menu));
          child = last->submenu;
@@ -567,6 +570,7 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
 
          value = FindAttribute(start->attributes, ICON_ATTRIBUTE);
          last->iconName = CopyString(value);
+         PreloadIcon(value);
 
          last->action.type = MA_EXECUTE;
          last->action.str = CopyString(start->value);
@@ -608,6 +612,7 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
 
          value = FindAttribute(start->attributes, ICON_ATTRIBUTE);
          last->iconName = CopyString(value);
+         PreloadIcon(value);
 
          switch(start->type) {
          case TOK_DESKTOPS:
@@ -667,6 +672,7 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
 
          value = FindAttribute(start->attributes, ICON_ATTRIBUTE);
          last->iconName = CopyString(value);
+         PreloadIcon(value);
 
          last->action.type = MA_EXIT;
          last->action.str = CopyString(start->value);
@@ -687,6 +693,7 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
 
          value = FindAttribute(start->attributes, ICON_ATTRIBUTE);
          last->iconName = CopyString(value);
+         PreloadIcon(value);
 
          last->action.type = MA_RESTART;
 
@@ -940,6 +947,7 @@ void ParseDesktops(const TokenNode *tp) {
    TokenNode *np;
    const char *width;
    const char *height;
+   const char *cache;
    int desktop;
 
    Assert(tp);
@@ -953,6 +961,10 @@ void ParseDesktops(const TokenNode *tp) {
       settings.desktopHeight = ParseUnsigned(tp, height);
    }
    settings.desktopCount = settings.desktopWidth * settings.desktopHeight;
+   cache = FindAttribute(tp->attributes, "backgroundcache");
+   if(cache != NULL) {
+      settings.backgroundCacheSize = ParseUnsigned(tp, cache);
+   }
 
    desktop = 0;
    for(np = tp->subnodeHead; np; np = np->next) {
@@ -1626,6 +1638,7 @@ void ParseGroupOption(const TokenNode *tp, struct GroupType *group,
       AddGroupOptionUnsigned(group, OPTION_DESKTOP, desktop);
    } else if(!strncmp(option, "icon:", 5)) {
       AddGroupOptionString(group, OPTION_ICON, option + 5);
+      PreloadIcon(option + 5);
    } else if(!strncmp(option, "opacity:", 8)) {
       const unsigned int opacity = ParseOpacity(tp, option + 8);
       AddGroupOptionUnsigned(group, OPTION_OPACITY, opacity);
@@ -25,13 +25,17 @@ typedef struct PopupType {
    int mx, my; /* The mouse position when the popup was created. */
    Window mw;
    int width, height;
+   int textWidth;    /* Width of the text. */
+   int drawnWidth;   /* Width rendered to the pixmap (0 if none). */
    char *text;
    Window window;
-   Pixmap pmap;
+   Pixmap pmap;      /* Sized for the widest possible popup. */
+   char isMapped;
 } PopupType;
 
 static PopupType popup;
 
+static void HidePopup(void);
 static void SignalPopup(const TimeType *now, int x, int y, Window w,
                         void *data);
 
@@ -40,6 +44,7 @@ void StartupPopup(void)
 {
    popup.text = NULL;
    popup.window = None;
+   popup.isMapped = 0;
    RegisterCallback(100, SignalPopup, NULL);
 }
 
@@ -53,8 +58,10 @@ void ShutdownPopup(void)
    }
    if(popup.window != None) {
       JXDestroyWindow(display, popup.window);
+      ReleaseTextDrawable(popup.pmap);
       JXFreePixmap(display, popup.pmap);
       popup.window = None;
+      popup.isMapped = 0;
    }
 }
 
@@ -72,12 +79,15 @@ void ShowPopup(int x, int y, const char *text,
    }
 
    if(popup.text) {
-      if(x == popup.x && y == popup.y && !strcmp(popup.text, text)) {
-         // This popup is already shown.
-         return;
+      if(!strcmp(popup.text, text)) {
+         if(x == popup.x && y == popup.y) {
+            // This popup is already shown.
+            return;
+         }
+      } else {
+         Release(popup.text);
+         popup.text = NULL;
       }
-      Release(popup.text);
-      popup.text = NULL;
    }
 
    if(text[0] == 0) {
@@ -85,9 +95,13 @@ void ShowPopup(int x, int y, const char *text,
    }
 
    GetMousePosition(&popup.mx, &popup.my, &popup.mw);
-   popup.text = CopyString(text);
+   if(!popup.text) {
+      popup.text = CopyString(text);
+      popup.textWidth = GetStringWidth(FONT_POPUP, popup.text);
+      popup.drawnWidth = 0;
+   }
    popup.height = GetStringHeight(FONT_POPUP) + 2;
-   popup.width = GetStringWidth(FONT_POPUP, popup.text) + 9;
+   popup.width = popup.textWidth + 9;
 
    sp = GetCurrentScreen(x, y);
 
@@ -138,42 +152,58 @@ void ShowPopup(int x, int y, const char *text,
                                     CopyFromParent, attrMask, &attr);
       SetAtomAtom(popup.window, ATOM_NET_WM_WINDOW_TYPE,
                   ATOM_NET_WM_WINDOW_TYPE_NOTIFICATION);
-      JXMapRaised(display, popup.window);
+
+      /* No popup is wider than the root window. */
+      popup.pmap = JXCreatePixmap(display, popup.window,
+                                  rootWidth, popup.height, rootDepth);
 
    } else {
 
       JXMoveResizeWindow(display, popup.window, popup.x, popup.y,
                          popup.width, popup.height);
-      JXFreePixmap(display, popup.pmap);
 
    }
 
-   popup.pmap = JXCreatePixmap(display, popup.window,
-                               popup.width, popup.height,
-                               rootDepth);
+   /* Only render when the text or its clipping changes. */
+   if(popup.drawnWidth != popup.width) {
+      JXSetForeground(display, rootGC, colors[COLOR_POPUP_BG]);
+      JXFillRectangle(display, popup.pmap, rootGC, 0, 0,
+                      popup.width - 1, popup.height - 1);
+      JXSetForeground(display, rootGC, colors[COLOR_POPUP_OUTLINE]);
+      JXDrawRectangle(display, popup.pmap, rootGC, 0, 0,
+                      popup.width - 1, popup.height - 1);
+      RenderString(popup.pmap, FONT_POPUP, COLOR_POPUP_FG, 4, 1,
+                   popup.width, popup.text);
+      popup.drawnWidth = popup.width;
+   }
 
-   JXSetForeground(display, rootGC, colors[COLOR_POPUP_BG]);
-   JXFillRectangle(display, popup.pmap, rootGC, 0, 0,
-                   popup.width - 1, popup.height - 1);
-   JXSetForeground(display, rootGC, colors[COLOR_POPUP_OUTLINE]);
-   JXDrawRectangle(display, popup.pmap, rootGC, 0, 0,
-                   popup.width - 1, popup.height - 1);
-   RenderString(popup.pmap, FONT_POPUP, COLOR_POPUP_FG, 4, 1,
-                popup.width, popup.text);
-   JXCopyArea(display, popup.pmap, popup.window, rootGC,
-              0, 0, popup.width, popup.height, 0, 0);
+   if(popup.isMapped) {
+      JXCopyArea(display, popup.pmap, popup.window, rootGC,
+                 0, 0, popup.width, popup.height, 0, 0);
+   } else {
+      /* The pixmap is copied when the window is exposed. */
+      JXMapRaised(display, popup.window);
+      popup.isMapped = 1;
+   }
 
 }
 
+/** Hide the popup window, keeping it for the next popup. */
+void HidePopup(void)
+{
+   if(popup.isMapped) {
+      JXUnmapWindow(display, popup.window);
+      popup.isMapped = 0;
+   }
+}
+
 /** Signal popup (this is used to hide popups after awhile). */
 void SignalPopup(const TimeType *now, int x, int y, Window w, void *data)
 {
-   if(popup.window != None) {
+   if(popup.isMapped) {
       if(popup.mw != w ||
          abs(popup.mx - x) > 0 || abs(popup.my - y) > 0) {
-         JXDestroyWindow(display, popup.window);
-         JXFreePixmap(display, popup.pmap);
-         popup.window = None;
+         HidePopup();
       }
    }
 }
@@ -186,9 +216,7 @@ char ProcessPopupEvent(const XEvent *event)
          JXCopyArea(display, popup.pmap, popup.window, rootGC,
                     0, 0, popup.width, popup.height, 0, 0);
       } else if(event->type == MotionNotify) {
-         JXDestroyWindow(display, popup.window);
-         JXFreePixmap(display, popup.pmap);
-         popup.window = None;
+         HidePopup();
       }
       return 1;
    }
@@ -13,61 +13,32 @@
 #include "image.h"
 #include "main.h"
 #include "color.h"
+#include "shm.h"
 
 /** Draw a scaled icon. */
-void PutScaledRenderIcon(const ImageNode *image,
+void PutScaledRenderIcon(const ScaledIconNode *node,
                          Drawable d, int x, int y)
 {
 
 #ifdef USE_XRENDER
 
-   Picture source;
-   const ScaledIconNode *node = image->nodes;
-
-   Assert(image);
+   Assert(node);
    Assert(haveRender);
 
-   source = node->imagePicture;
-   if(source != None) {
+   if(node->imagePicture != None) {
 
       XRenderPictureAttributes pa;
-      XTransform xf;
-      int width, height;
-      int xscale, yscale;
       Picture dest;
-      Picture alpha = node->alphaPicture;
       XRenderPictFormat *fp = JXRenderFindVisualFormat(display, rootVisual);
       Assert(fp);
 
       pa.subwindow_mode = IncludeInferiors;
       dest = JXRenderCreatePicture(display, d, fp, CPSubwindowMode, &pa);
 
-      if(node->width == 0) {
-         width = image->width;
-         xscale = 65536;
-      } else {
-         width = node->width;
-         xscale = (image->width << 16) / width;
-      }
-      if(node->height == 0) {
-         height = image->height;
-         yscale = 65536;
-      } else {
-         height = node->height;
-         yscale = (image->height << 16) / height;
-      }
-
-      memset(&xf, 0, sizeof(xf));
-      xf.matrix[0][0] = xscale;
-      xf.matrix[1][1] = yscale;
-      xf.matrix[2][2] = 65536;
-      XRenderSetPictureTransform(display, source, &xf);
-      XRenderSetPictureFilter(display, source, FilterBest, NULL, 0);
-      XRenderSetPictureTransform(display, alpha, &xf);
-      XRenderSetPictureFilter(display, alpha, FilterBest, NULL, 0);
-
-      JXRenderComposite(display, PictOpOver, source, alpha, dest,
-                        0, 0, 0, 0, x, y, width, height);
+      /* The node is already at the right size; no transform needed. */
+      JXRenderComposite(display, PictOpOver, node->imagePicture,
+                        node->alphaPicture, dest,
+                        0, 0, 0, 0, x, y, node->width, node->height);
 
       JXRenderFreePicture(display, dest);
 
@@ -77,6 +48,76 @@ void PutScaledRenderIcon(const ImageNode *image,
 
 }
 
+/** Create a scaled copy of a render icon. */
+ScaledIconNode *CreateScaledRenderCopy(ImageNode *image,
+                                       const ScaledIconNode *base,
+                                       int width, int height)
+{
+
+   ScaledIconNode *result = NULL;
+
+#ifdef USE_XRENDER
+
+   XRenderPictFormat *fp;
+   XTransform xf;
+
+   Assert(haveRender);
+   Assert(base);
+
+   result = Allocate(sizeof(ScaledIconNode));
+   result->fg = base->fg;
+   result->width = width;
+   result->height = height;
+   result->image = None;
+   result->mask = None;
+   result->next = image->nodes;
+   image->nodes = result;
+
+   /* Create the destination pictures. */
+   fp = JXRenderFindVisualFormat(display, rootVisual);
+   Assert(fp);
+   result->image = JXCreatePixmap(display, rootWindow, width, height,
+                                  rootDepth);
+   result->imagePicture = JXRenderCreatePicture(display, result->image, fp,
+                                                0, NULL);
+   fp = JXRenderFindStandardFormat(display, PictStandardA8);
+   Assert(fp);
+   result->mask = JXCreatePixmap(display, rootWindow, width, height, 8);
+   result->alphaPicture = JXRenderCreatePicture(display, result->mask, fp,
+                                                0, NULL);
+
+   /* Scale the full size pictures once. */
+   memset(&xf, 0, sizeof(xf));
+   xf.matrix[0][0] = (image->width << 16) / width;
+   xf.matrix[1][1] = (image->height << 16) / height;
+   xf.matrix[2][2] = 65536;
+   XRenderSetPictureTransform(display, base->imagePicture, &xf);
+   XRenderSetPictureFilter(display, base->imagePicture, FilterBest, NULL, 0);
+   XRenderSetPictureTransform(display, base->alphaPicture, &xf);
+   XRenderSetPictureFilter(display, base->alphaPicture, FilterBest, NULL, 0);
+   JXRenderComposite(display, PictOpSrc, base->imagePicture, None,
+                     result->imagePicture, 0, 0, 0, 0, 0, 0, width, height);
+   JXRenderComposite(display, PictOpSrc, base->alphaPicture, None,
+                     result->alphaPicture, 0, 0, 0, 0, 0, 0, width, height);
+
+   /* Restore the identity transform so the base can be drawn as is. */
+   xf.matrix[0][0] = 65536;
+   xf.matrix[1][1] = 65536;
+   XRenderSetPictureTransform(display, base->imagePicture, &xf);
+   XRenderSetPictureTransform(display, base->alphaPicture, &xf);
+
+   /* Free unneeded pixmaps. */
+   JXFreePixmap(display, result->image);
+   result->image = None;
+   JXFreePixmap(display, result->mask);
+   result->mask = None;
+
+#endif
+
+   return result;
+
+}
+
 /** Create a scaled icon. */
 ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
 {
@@ -94,6 +135,7 @@ ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
    const unsigned int height = image->height;
    int x, y;
    int maskLine;
+   char direct;
 
    Assert(haveRender);
 
@@ -107,17 +149,16 @@ ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
    result->image = JXCreatePixmap(display, rootWindow, width, height,
                                   rootDepth);
 
-   destImage = JXCreateImage(display, rootVisual, rootDepth,
-                             ZPixmap, 0, NULL, width, height, 8, 0);
-   destImage->data = Allocate(sizeof(unsigned long) * width * height);
+   destImage = CreateUploadImage(rootDepth, width, height);
+   direct = IsRGB32Image(destImage);
 
-   destMask = JXCreateImage(display, rootVisual, 8, ZPixmap,
-                            0, NULL, width, height, 8, 0);
-   destMask->data = Allocate(width * height);
+   destMask = CreateUploadImage(8, width, height);
 
    maskLine = 0;
    for(y = 0; y < height; y++) {
       const int yindex = y * image->width;
+      CARD32 *row = (CARD32*)(destImage->data
+                              + y * destImage->bytes_per_line);
       for(x = 0; x < width; x++) {
          if(image->bitmap) {
 
@@ -135,19 +176,30 @@ ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
 
             const int index = 4 * (yindex + x);
             const unsigned long alpha = image->data[index];
-            color.red = image->data[index + 1];
-            color.red |= color.red << 8;
-            color.green = image->data[index + 2];
-            color.green |= color.green << 8;
-            color.blue = image->data[index + 3];
-            color.blue |= color.blue << 8;
-
-            color.red = (color.red * alpha) >> 8;
-            color.green = (color.green * alpha) >> 8;
-            color.blue = (color.blue * alpha) >> 8;
-
-            GetColor(&color, 0);
-            XPutPixel(destImage, x, y, color.pixel);
+            if(direct) {
+               /* Fast path: premultiply and store 0xRRGGBB directly.
+                * This matches the rounding of the GetColor path. */
+               const unsigned long red = image->data[index + 1] * 257;
+               const unsigned long green = image->data[index + 2] * 257;
+               const unsigned long blue = image->data[index + 3] * 257;
+               row[x] = (CARD32)((((red * alpha) >> 16) << 16)
+                               | (((green * alpha) >> 16) << 8)
+                               | ((blue * alpha) >> 16));
+            } else {
+               color.red = image->data[index + 1];
+               color.red |= color.red << 8;
+               color.green = image->data[index + 2];
+               color.green |= color.green << 8;
+               color.blue = image->data[index + 3];
+               color.blue |= color.blue << 8;
+
+               color.red = (color.red * alpha) >> 8;
+               color.green = (color.green * alpha) >> 8;
+               color.blue = (color.blue * alpha) >> 8;
+
+               GetColor(&color, 0);
+               XPutPixel(destImage, x, y, color.pixel);
+            }
             destMask->data[maskLine + x] = alpha;
          }
       }
@@ -155,18 +207,12 @@ ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
    }
 
    /* Render the image data to the image pixmap. */
-   JXPutImage(display, result->image, rootGC, destImage,
-              0, 0, 0, 0, width, height);
-   Release(destImage->data);
-   destImage->data = NULL;
-   JXDestroyImage(destImage);
+   PutUploadImage(result->image, rootGC, destImage, width, height);
+   DestroyUploadImage(destImage);
 
    /* Render the alpha data to the mask pixmap. */
-   JXPutImage(display, result->mask, maskGC, destMask, 0, 0, 0, 0,
-              width, height);
-   Release(destMask->data);
-   destMask->data = NULL;
-   JXDestroyImage(destMask);
+   PutUploadImage(result->mask, maskGC, destMask, width, height);
+   DestroyUploadImage(destMask);
    JXFreeGC(display, maskGC);
 
    /* Create the alpha picture. */
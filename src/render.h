@@ -15,15 +15,27 @@ struct ImageNode;
 struct ScaledIconNode;
 
 /** Put a scaled icon.
- * @param image The image to display.
+ * @param node The scaled icon to display.
  * @param d The drawable on which to render the icon.
  * @param x The x-coordinate to place the icon.
  * @param y The y-coordinate to place the icon.
- * @return 1 if the icon was successfully rendered, 0 otherwise.
  */
-void PutScaledRenderIcon(const struct ImageNode *image,
+void PutScaledRenderIcon(const struct ScaledIconNode *node,
                          Drawable d, int x, int y);
 
+/** Create a scaled copy of a render icon.
+ * The scaling is done by the server once so that drawing the copy
+ * is a plain composite.
+ * @param image The image the icon belongs to.
+ * @param base The full size render icon of the image.
+ * @param width The width of the copy.
+ * @param height The height of the copy.
+ * @return The scaled icon, which is added to the image.
+ */
+struct ScaledIconNode *CreateScaledRenderCopy(struct ImageNode *image,
+                                              const struct ScaledIconNode *base,
+                                              int width, int height);
+
 /** Create a scaled icon.
  * @param icon The icon.
  * @param fg The foreground color (for bitmaps).
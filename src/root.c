@@ -62,6 +62,19 @@ void StartupRootMenu(void)
 
 }
 
+/** Shutdown root menus.
+ * Rendered menus are kept until the configuration is reloaded.
+ */
+void ShutdownRootMenu(void)
+{
+   unsigned int x;
+   for(x = 0; x < ROOT_MENU_COUNT; x++) {
+      if(rootMenu[x]) {
+         ReleaseMenuWindows(rootMenu[x]);
+      }
+   }
+}
+
 /** Destroy root menu data. */
 void DestroyRootMenu(void)
 {
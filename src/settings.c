@@ -43,6 +43,7 @@ void InitializeSettings(void)
    settings.menuDecorations = DECO_FLAT;
    settings.exitConfirmation = 1;
    settings.cornerRadius = 4;
+   settings.backgroundCacheSize = 128;
    settings.groupTasks = 0;
 }
 
@@ -61,6 +62,7 @@ void StartupSettings(void)
    FixRange(&settings.desktopWidth, 1, 64, 4);
    FixRange(&settings.desktopHeight, 1, 64, 1);
    settings.desktopCount = settings.desktopWidth * settings.desktopHeight;
+   FixRange(&settings.backgroundCacheSize, 0, 65536, 128);
 
 }
 
@@ -69,6 +69,7 @@ typedef struct {
    unsigned int menuOpacity;
    unsigned int desktopDelay;
    unsigned int cornerRadius;
+   unsigned int backgroundCacheSize;
    SnapModeType snapMode;
    MoveModeType moveMode;
    StatusWindowType moveStatusType;
@@ -0,0 +1,220 @@
+/**
+ * @file shm.c
+ * @author Joe Wingbermuehle
+ * @date 2014
+ *
+ * @brief Functions to upload images to the X server.
+ *
+ */
+
+#include "jwm.h"
+#include "shm.h"
+#include "main.h"
+
+#ifdef USE_SHM
+
+/** Images smaller than this are sent over the connection. */
+#define SHM_MIN_SIZE (64 * 1024)
+
+/** Segments larger than this are released after each upload. */
+#define SHM_KEEP_SIZE (4 * 1024 * 1024)
+
+/** Number of shared segments (for an image and its mask). */
+#define SHM_SEGMENT_COUNT 2
+
+/** A shared memory segment attached to the X server. */
+typedef struct SharedSegment {
+   XShmSegmentInfo info;
+   unsigned long size;     /**< Size of the segment (0 if none). */
+   char busy;              /**< Set while used by an image. */
+   char pending;           /**< Set if the server may still read it. */
+} SharedSegment;
+
+static SharedSegment segments[SHM_SEGMENT_COUNT];
+
+/** Set by HandleAttachError if the server could not attach a segment. */
+static char attachFailed;
+
+static SharedSegment *GetSegment(const XImage *image);
+static char AttachSegment(SharedSegment *sp, unsigned long size);
+static void DetachSegment(SharedSegment *sp);
+static int HandleAttachError(Display *d, XErrorEvent *e);
+
+#endif /* USE_SHM */
+
+/** Release shared memory segments. */
+void ShutdownShm(void)
+{
+#ifdef USE_SHM
+   unsigned int i;
+   for(i = 0; i < SHM_SEGMENT_COUNT; i++) {
+      DetachSegment(&segments[i]);
+   }
+#endif
+}
+
+/** Create an image to be uploaded. */
+XImage *CreateUploadImage(unsigned int depth,
+                          unsigned int width, unsigned int height)
+{
+
+   XImage *image;
+
+#ifdef USE_SHM
+   if(haveShm) {
+      SharedSegment *sp = NULL;
+      unsigned int i;
+      for(i = 0; i < SHM_SEGMENT_COUNT; i++) {
+         if(!segments[i].busy) {
+            sp = &segments[i];
+            break;
+         }
+      }
+      if(sp) {
+         image = JXShmCreateImage(display, rootVisual, depth, ZPixmap,
+                                  NULL, &sp->info, width, height);
+         if(image) {
+            const unsigned long size = image->bytes_per_line * height;
+            if(size >= SHM_MIN_SIZE && AttachSegment(sp, size)) {
+               image->data = sp->info.shmaddr;
+               sp->busy = 1;
+               return image;
+            }
+            JXDestroyImage(image);
+         }
+      }
+   }
+#endif
+
+   image = JXCreateImage(display, rootVisual, depth, ZPixmap, 0, NULL,
+                         width, height, 8, 0);
+   image->data = Allocate(image->bytes_per_line * height);
+   return image;
+
+}
+
+/** Upload an image. */
+void PutUploadImage(Drawable d, GC gc, XImage *image,
+                    unsigned int width, unsigned int height)
+{
+#ifdef USE_SHM
+   SharedSegment *sp = GetSegment(image);
+   if(sp) {
+      JXShmPutImage(display, d, gc, image, 0, 0, 0, 0, width, height, False);
+      sp->pending = 1;
+      return;
+   }
+#endif
+   JXPutImage(display, d, gc, image, 0, 0, 0, 0, width, height);
+}
+
+/** Destroy an image. */
+void DestroyUploadImage(XImage *image)
+{
+#ifdef USE_SHM
+   SharedSegment *sp = GetSegment(image);
+   if(sp) {
+      sp->busy = 0;
+      if(sp->size > SHM_KEEP_SIZE) {
+         DetachSegment(sp);
+      }
+   } else {
+      Release(image->data);
+   }
+#else
+   Release(image->data);
+#endif
+   image->data = NULL;
+   JXDestroyImage(image);
+}
+
+#ifdef USE_SHM
+
+/** Get the segment used by an image (NULL if not shared). */
+SharedSegment *GetSegment(const XImage *image)
+{
+   unsigned int i;
+   for(i = 0; i < SHM_SEGMENT_COUNT; i++) {
+      if(segments[i].busy && image->obdata == (char*)&segments[i].info) {
+         return &segments[i];
+      }
+   }
+   return NULL;
+}
+
+/** Make sure a segment of at least the specified size is attached.
+ * Segments are reused, so this waits for the server to finish reading
+ * the previous image.
+ */
+char AttachSegment(SharedSegment *sp, unsigned long size)
+{
+
+   XErrorHandler oldHandler;
+   Status status;
+
+   if(sp->size >= size) {
+      if(sp->pending) {
+         JXSync(display, False);
+         sp->pending = 0;
+      }
+      return 1;
+   }
+   DetachSegment(sp);
+
+   sp->info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+   if(JUNLIKELY(sp->info.shmid < 0)) {
+      Debug("shmget failed");
+      return 0;
+   }
+   sp->info.shmaddr = shmat(sp->info.shmid, NULL, 0);
+   if(JUNLIKELY(sp->info.shmaddr == (char*)-1)) {
+      Debug("shmat failed");
+      shmctl(sp->info.shmid, IPC_RMID, NULL);
+      return 0;
+   }
+   sp->info.readOnly = True;
+
+   /* The server may see our socket but not our segments (for example,
+    * from another IPC namespace), so check that the attach worked.
+    * Earlier errors are flushed to the normal handler first. */
+   JXSync(display, False);
+   attachFailed = 0;
+   oldHandler = JXSetErrorHandler(HandleAttachError);
+   status = JXShmAttach(display, &sp->info);
+   JXSync(display, False);
+   JXSetErrorHandler(oldHandler);
+
+   /* The segment is freed once both sides have detached. */
+   shmctl(sp->info.shmid, IPC_RMID, NULL);
+   if(JUNLIKELY(!status || attachFailed)) {
+      Debug("XShmAttach failed; using XPutImage");
+      shmdt(sp->info.shmaddr);
+      haveShm = 0;
+      return 0;
+   }
+   sp->size = size;
+   sp->pending = 0;
+   return 1;
+
+}
+
+/** Detach a segment from the server and from JWM. */
+void DetachSegment(SharedSegment *sp)
+{
+   if(sp->size > 0) {
+      JXShmDetach(display, &sp->info);
+      JXSync(display, False);
+      shmdt(sp->info.shmaddr);
+      sp->size = 0;
+      sp->pending = 0;
+   }
+}
+
+/** Record an error while attaching a segment. */
+int HandleAttachError(Display *d, XErrorEvent *e)
+{
+   attachFailed = 1;
+   return 0;
+}
+
+#endif /* USE_SHM */
@@ -0,0 +1,46 @@
+/**
+ * @file shm.h
+ * @author Joe Wingbermuehle
+ * @date 2014
+ *
+ * @brief Functions to upload images to the X server.
+ *
+ */
+
+#ifndef SHM_H
+#define SHM_H
+
+/*@{*/
+#define InitializeShm() (void)(0)
+#define StartupShm()    (void)(0)
+void ShutdownShm(void);
+#define DestroyShm()    (void)(0)
+/*@}*/
+
+/** Create an image to be uploaded with PutUploadImage.
+ * Large images are placed in a shared memory segment when the X server
+ * supports MIT-SHM and is local.
+ * @param depth The depth of the image.
+ * @param width The width of the image.
+ * @param height The height of the image.
+ * @return A ZPixmap image with its data allocated.
+ */
+XImage *CreateUploadImage(unsigned int depth,
+                          unsigned int width, unsigned int height);
+
+/** Upload an image created with CreateUploadImage.
+ * @param d The destination drawable.
+ * @param gc The graphics context to use.
+ * @param image The image.
+ * @param width The width of the area to upload.
+ * @param height The height of the area to upload.
+ */
+void PutUploadImage(Drawable d, GC gc, XImage *image,
+                    unsigned int width, unsigned int height);
+
+/** Destroy an image created with CreateUploadImage.
+ * @param image The image to destroy.
+ */
+void DestroyUploadImage(XImage *image);
+
+#endif /* SHM_H */
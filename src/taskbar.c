@@ -93,6 +93,7 @@ void ShutdownTaskBar(void)
 {
    TaskBarType *bp;
    for(bp = bars; bp; bp = bp->next) {
+      ReleaseTextDrawable(bp->buffer);
       JXFreePixmap(display, bp->buffer);
    }
 }
@@ -181,6 +182,7 @@ void Resize(TrayComponentType *cp)
 {
    TaskBarType *tp = (TaskBarType*)cp->object;
    if(tp->buffer != None) {
+      ReleaseTextDrawable(tp->buffer);
       JXFreePixmap(display, tp->buffer);
    }
    cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width, cp->height,
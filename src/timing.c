@@ -90,3 +90,31 @@ const char *GetTimeString(const char *format, const char *zone)
 
    return str;
 }
+
+/** Get the smallest unit of time that changes a time string. */
+unsigned int GetTimeFormatUnit(const char *format)
+{
+   /* Conversions that can only change on a minute boundary. */
+   static const char *MINUTE_CONVERSIONS
+      = "aAbBCdDeFgGhHIjklmMnpPRtuUVwWyYzZ%";
+   const char *cp;
+
+   for(cp = format; *cp; cp++) {
+      if(*cp != '%') {
+         continue;
+      }
+      cp += 1;
+
+      /* Skip flags, field widths, and the E and O modifiers. */
+      while(*cp && strchr("_-0^#EO123456789", *cp)) {
+         cp += 1;
+      }
+      if(*cp == 0) {
+         break;
+      }
+      if(!strchr(MINUTE_CONVERSIONS, *cp)) {
+         return 1;
+      }
+   }
+   return 60;
+}
@@ -43,5 +43,13 @@ unsigned long GetTimeDifference(const TimeType *t1, const TimeType *t2);
  */
 const char *GetTimeString(const char *format, const char *zone);
 
+/** Get the smallest unit of time that changes a time string.
+ * Units coarser than a minute are reported as a minute since the time
+ * zone offset may not be a whole number of hours.
+ * @param format The strftime format.
+ * @return The unit in seconds (1 or 60).
+ */
+unsigned int GetTimeFormatUnit(const char *format);
+
 #endif /* TIMING_H */
 
@@ -239,6 +239,7 @@ TrayType *CreateTray(void)
 
    tp->autoHide = THIDE_OFF;
    tp->hidden = 0;
+   tp->damaged = 0;
 
    tp->window = None;
 
@@ -272,6 +273,7 @@ TrayComponentType *CreateTrayComponent(void)
    cp->width = 0;
    cp->height = 0;
    cp->grabbed = 0;
+   cp->damaged = 0;
 
    cp->window = None;
    cp->pixmap = None;
@@ -808,7 +810,7 @@ void DrawTray(void)
 }
 
 /** Draw a specific tray. */
-void DrawSpecificTray(const TrayType *tp)
+void DrawSpecificTray(TrayType *tp)
 {
 
    TrayComponentType *cp;
@@ -857,21 +859,49 @@ void LowerTrays(void)
 }
 
 /** Update a specific component on a tray. */
-void UpdateSpecificTray(const TrayType *tp, const TrayComponentType *cp)
+void UpdateSpecificTray(TrayType *tp, TrayComponentType *cp)
 {
 
    if(JUNLIKELY(shouldExit)) {
       return;
    }
 
-   /* If the tray is hidden, draw only the background. */
+   /* Mark the component for the next flush. */
    if(cp->pixmap != None) {
-      JXCopyArea(display, cp->pixmap, tp->window, rootGC, 0, 0,
-                 cp->width, cp->height, cp->x, cp->y);
+      cp->damaged = 1;
+      if(!tp->damaged) {
+         tp->damaged = 1;
+         RequireTrayUpdate();
+      }
    }
 
 }
 
+/** Copy damaged tray components to the tray windows. */
+void FlushTrays(void)
+{
+   TrayType *tp;
+   TrayComponentType *cp;
+
+   if(JUNLIKELY(shouldExit)) {
+      return;
+   }
+
+   for(tp = trays; tp; tp = tp->next) {
+      if(!tp->damaged) {
+         continue;
+      }
+      for(cp = tp->components; cp; cp = cp->next) {
+         if(cp->damaged && cp->pixmap != None && tp->window != None) {
+            JXCopyArea(display, cp->pixmap, tp->window, rootGC, 0, 0,
+                       cp->width, cp->height, cp->x, cp->y);
+         }
+         cp->damaged = 0;
+      }
+      tp->damaged = 0;
+   }
+}
+
 /** Layout tray components on a tray. */
 void LayoutTray(TrayType *tp, int *variableSize, int *variableRemainder)
 {
@@ -1035,7 +1065,7 @@ void ClearTrayDrawable(const TrayComponentType *cp)
       JXSetForeground(display, rootGC, colors[COLOR_TRAY_BG1]);
       JXFillRectangle(display, d, rootGC, 0, 0, cp->width, cp->height);
    } else {
-      DrawHorizontalGradient(d, rootGC, colors[COLOR_TRAY_BG1],
+      DrawHorizontalGradient(d, colors[COLOR_TRAY_BG1],
                              colors[COLOR_TRAY_BG2], 0, 0,
                              cp->width, cp->height);
    }
@@ -77,6 +77,7 @@ typedef struct TrayComponentType {
    int height;    /**< Actual height. */
 
    char grabbed;     /**< 1 if the mouse was grabbed by this component. */
+   char damaged;     /**< 1 if the pixmap needs to be copied to the tray. */
 
    Window window;    /**< Content (if a window, otherwise None). */
    Pixmap pixmap;    /**< Content (if a pixmap, otherwise None). */
@@ -141,6 +142,7 @@ typedef struct TrayType {
 
    TrayAutoHideType  autoHide;
    char hidden;     /**< 1 if hidden (due to autohide), 0 otherwise. */
+   char damaged;    /**< 1 if any component needs to be copied. */
 
    Window window; /**< The tray window. */
 
@@ -194,7 +196,7 @@ void DrawTray(void);
 /** Draw a specific tray.
  * @param tp The tray to draw.
  */
-void DrawSpecificTray(const TrayType *tp);
+void DrawSpecificTray(TrayType *tp);
 
 /** Raise tray windows. */
 void RaiseTrays(void);
@@ -203,10 +205,15 @@ void RaiseTrays(void);
 void LowerTrays(void);
 
 /** Update a component on a tray.
+ * The component is copied to the tray by FlushTrays, so several updates
+ * before waiting for the next event result in a single copy.
  * @param tp The tray containing the component.
  * @param cp The component that needs updating.
  */
-void UpdateSpecificTray(const TrayType *tp, const TrayComponentType *cp);
+void UpdateSpecificTray(TrayType *tp, TrayComponentType *cp);
+
+/** Copy updated components to their trays. */
+void FlushTrays(void);
 
 /** Resize a tray.
  * @param tp The tray to resize containing the new requested size information.
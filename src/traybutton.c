@@ -137,6 +137,7 @@ TrayComponentType *CreateTrayButton(const char *iconName,
 
    bp->icon = NULL;
    bp->iconName = CopyString(iconName);
+   PreloadIcon(iconName);
    bp->label = CopyString(label);
    bp->actions = NULL;
    bp->popup = CopyString(popup);
@@ -247,6 +248,7 @@ void Resize(TrayComponentType *cp)
 void Destroy(TrayComponentType *cp)
 {
    if(cp->pixmap != None) {
+      ReleaseTextDrawable(cp->pixmap);
       JXFreePixmap(display, cp->pixmap);
    }
 }
@@ -19,19 +19,103 @@
 #include "root.h"
 #include "settings.h"
 
+/** Number of window menus to keep rendered. */
+#define WINDOW_MENU_CACHE_SIZE 4
+
+/** Client status bits that affect the window menu. */
+#define WINDOW_MENU_STATUS (STAT_WMDIALOG | STAT_FULLSCREEN | STAT_MINIMIZED \
+                            | STAT_MAPPED | STAT_SHADED | STAT_STICKY)
+
+/** A window menu built for a particular client state.
+ * The items only depend on the state, so the menu (and its window and
+ * pixmap) can be reused for any client with the same state.
+ */
+typedef struct WindowMenuCacheType {
+   Menu *menu;
+   ClientState state;
+} WindowMenuCacheType;
+
+static WindowMenuCacheType windowMenuCache[WINDOW_MENU_CACHE_SIZE];
+static unsigned int nextWindowMenu = 0;
+
+static Menu *GetCachedWindowMenu(ClientNode *np);
+static void GetWindowMenuState(const ClientNode *np, ClientState *state);
+static void SetWindowMenuContext(Menu *menu, ClientNode *np);
 static void CreateWindowLayerMenu(Menu *menu, ClientNode *np);
 static void CreateWindowSendToMenu(Menu *menu, ClientNode *np);
 static void AddWindowMenuItem(Menu *menu, const char *name,
                               MenuActionType type,
                               ClientNode *np, int value);
 
+/** Release cached window menus. */
+void ShutdownWindowMenu(void)
+{
+   unsigned int x;
+   for(x = 0; x < WINDOW_MENU_CACHE_SIZE; x++) {
+      DestroyMenu(windowMenuCache[x].menu);
+      windowMenuCache[x].menu = NULL;
+   }
+   nextWindowMenu = 0;
+}
+
 /** Show a window menu. */
 void ShowWindowMenu(ClientNode *np, int x, int y, char keyboard)
 {
-   Menu *menu = CreateWindowMenu(np);
-   InitializeMenu(menu);
+   Menu *menu = GetCachedWindowMenu(np);
    ShowMenu(menu, RunWindowCommand, x, y, keyboard);
-   DestroyMenu(menu);
+}
+
+/** Get a window menu for a client, creating it if necessary. */
+Menu *GetCachedWindowMenu(ClientNode *np)
+{
+
+   WindowMenuCacheType *cp;
+   ClientState state;
+   unsigned int x;
+
+   GetWindowMenuState(np, &state);
+   for(x = 0; x < WINDOW_MENU_CACHE_SIZE; x++) {
+      cp = &windowMenuCache[x];
+      if(cp->menu && !memcmp(&cp->state, &state, sizeof(state))) {
+         SetWindowMenuContext(cp->menu, np);
+         return cp->menu;
+      }
+   }
+
+   /* Not found; replace the oldest entry. */
+   cp = &windowMenuCache[nextWindowMenu];
+   nextWindowMenu = (nextWindowMenu + 1) % WINDOW_MENU_CACHE_SIZE;
+   DestroyMenu(cp->menu);
+   cp->menu = CreateWindowMenu(np);
+   cp->state = state;
+   InitializeMenu(cp->menu);
+   return cp->menu;
+
+}
+
+/** Get the parts of the client state shown in the window menu. */
+void GetWindowMenuState(const ClientNode *np, ClientState *state)
+{
+   memset(state, 0, sizeof(ClientState));
+   state->status = np->state.status & WINDOW_MENU_STATUS;
+   state->border = np->state.border;
+   state->maxFlags = np->state.maxFlags;
+   state->layer = np->state.layer;
+   if(!(np->state.status & STAT_STICKY)) {
+      state->desktop = np->state.desktop;
+   }
+}
+
+/** Point the actions of a cached window menu at a client. */
+void SetWindowMenuContext(Menu *menu, ClientNode *np)
+{
+   MenuItem *item;
+   for(item = menu->items; item; item = item->next) {
+      item->action.context = np;
+      if(item->submenu) {
+         SetWindowMenuContext(item->submenu, np);
+      }
+   }
 }
 
 /** Create a new window menu. */
@@ -14,6 +14,13 @@
 
 struct ClientNode;
 
+/*@{*/
+#define InitializeWindowMenu() (void)(0)
+#define StartupWindowMenu()    (void)(0)
+void ShutdownWindowMenu(void);
+#define DestroyWindowMenu()    (void)(0)
+/*@}*/
+
 /** Create a window menu. */
 Menu *CreateWindowMenu(struct ClientNode *np);
 